@@ -1,31 +1,164 @@
 #define _XOPEN_SOURCE 700  // expõe pthread rwlocks e outras POSIX funções
+#define _DEFAULT_SOURCE    // MAP_POPULATE e madvise()
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <errno.h>
 
 #include "cache.h"
+#include "cache_fd.h"
+#include "cache_gzip.h"
+#include "cache_shm.h"
+#include "cache_watch.h"
+#include "http.h"
+#include "mime.h"
+
+#define INDEX_INITIAL_CAPACITY 256                   // slots iniciais do índice de cada shard (potência de 2)
+#define REBALANCE_INTERVAL_NS  1000000000ULL         // orçamentos redistribuídos no máximo 1x por segundo
+#define REVALIDATE_INTERVAL_NS 1000000000ULL         // sem inotify fiável: stat() no máximo 1x por segundo por entrada
+#define CANONICAL_PATH_MAX     1024
+
+#define WINDOW_PERCENT  1                            // janela de admissão: 1% do orçamento do shard
+#define SKETCH_DEPTH    4                            // linhas do count-min sketch
+#define SKETCH_WIDTH    4096                         // contadores por linha (potência de 2, <= 65536)
+#define SKETCH_MAX      15                           // contadores saturam aqui (4 bits chegam)
+#define SKETCH_SAMPLE   (10 * SKETCH_WIDTH)          // incrementos entre envelhecimentos
+
+#define NEGATIVE_SLOTS  256                          // caminhos inexistentes lembrados por shard (potência de 2)
+
+#define RESPONSE_HEADER_MAX 384                      // cada header 200 pré-formatado (close / keep-alive)
+#define RESPONSE_RESERVE    (2 * RESPONSE_HEADER_MAX)    // espaço à frente do corpo para os dois
+
+#define GZIP_MIN_SIZE   256                          // abaixo disto o gzip quase não poupa nada
+
+/* Variante gzip de uma entrada: block = [headers][corpo comprimido], como o das entradas */
+typedef struct {
+    char* block;
+    char* data;
+    size_t size;
+    char* header[2];            // com Content-Encoding e Vary: [0] close, [1] keep-alive
+    size_t header_len[2];
+    http_validators_t validators;   // ETag da entrada com "-gz" (outra representação)
+} gzip_variant_t;
 
 typedef struct cache_entry {
     char* path;                 // caminho completo do ficheiro
+    uint64_t hash;              // hash do caminho (calculado uma vez por pedido)
     char* data;                 // dados do ficheiro
     size_t size;                // tamanho em bytes
-    struct cache_entry* prev;   // mais recente à frente
-    struct cache_entry* next;   // mais antigo atrás
+    size_t bytes;               // o que conta no orçamento do shard: size + variante gzip
+    int mapped;                 // 1 se data é um mmap() só de leitura do ficheiro (CACHE_MMAP)
+    char* block;                // malloc com [headers][data] (só os headers se data é um mmap)
+    const char* content_type;   // tipo MIME (string estática de mime_name), usado nos headers
+    http_validators_t validators;   // ETag e Last-Modified, formatados ao carregar
+    char* header[2];            // resposta 200 pré-formatada: [0] close, [1] keep-alive (NULL => sem)
+    size_t header_len[2];
+    int compressible;           // tipo de texto com Vary: pode ganhar uma variante gzip
+    _Atomic(gzip_variant_t*) gzip;  // publicada uma vez, com o WRLOCK (NULL => só a original)
+    atomic_uchar referenced;    // bit do CLOCK: ligado em cada hit (só com RDLOCK)
+    atomic_int refs;            // 1 do cache (enquanto está no shard) + 1 por pedido em curso
+    int64_t mtime_ns;           // data de modificação do ficheiro quando foi lido
+    _Atomic uint64_t verified_ns;   // última vez que se confirmou que o ficheiro não mudou
+    int in_window;              // 1 enquanto está na janela de admissão, 0 no espaço principal
+    struct cache_entry* prev;   // anel circular do CLOCK (da janela ou do espaço principal)
+    struct cache_entry* next;
 } cache_entry_t;
 
+/* Resultado de um carregamento em curso (single-flight) */
+enum { FLIGHT_LEADER = 0, FLIGHT_CACHED, FLIGHT_UNCACHED, FLIGHT_FAILED };
+
+/* Um miss a ser carregado do disco; outros pedidos ao mesmo ficheiro esperam por ele */
+typedef struct cache_flight {
+    uint64_t hash;
+    const char* path;           // caminho do pedido do líder
+    int status;                 // FLIGHT_LEADER enquanto carrega, depois o resultado
+    int err;                    // errno do líder quando FLIGHT_FAILED
+    int refs;                   // líder + threads à espera (liberta a 0)
+    struct cache_flight* next;
+} cache_flight_t;
+
+/* Um caminho que não existia no disco (cache negativo, mapeamento direto pelo hash) */
+typedef struct {
+    uint64_t hash;
+    uint64_t expires_ns;        // 0 => slot livre
+    char* path;
+} cache_negative_t;
+
+/*
+ * Um shard é um cache completo (lock, índice, anel CLOCK, orçamento) para os
+ * caminhos cujo hash lhe calha. Pedidos a ficheiros de shards diferentes nunca
+ * disputam o mesmo lock. Alinhado a 64 bytes para não partilhar cache lines.
+ */
+typedef struct {
+    _Alignas(64) pthread_rwlock_t lock;
+    cache_entry_t* hand;            // ponteiro do CLOCK do espaço principal (NULL => vazio)
+    cache_entry_t* window_hand;     // ponteiro do CLOCK da janela de admissão
+    size_t total_bytes;             // bytes atualmente no shard (janela + principal)
+    size_t window_bytes;            // bytes na janela
+    size_t max_bytes;               // orçamento atual (ajustado pelo rebalanceamento)
+    size_t pressure_bytes;          // bytes despejados/recusados desde o último rebalanceamento
+
+    /* Índice: tabela de hash com endereçamento aberto (linear probing) sobre as
+       mesmas entradas do anel do CLOCK. Slots vazios são NULL; a ocupação fica
+       abaixo de 50% para as sequências de probing serem curtas. */
+    cache_entry_t** index;
+    size_t index_cap;               // nº de slots (potência de 2)
+    size_t index_count;             // entradas no índice
+
+    /* Frequência aproximada de acesso (count-min sketch) de todos os caminhos
+       pedidos a este shard, em cache ou não. Atualizado também com o RDLOCK
+       (contadores atómicos; um incremento perdido numa corrida não importa). */
+    atomic_uchar* sketch;           // SKETCH_DEPTH x SKETCH_WIDTH contadores
+    atomic_long sketch_additions;   // incrementos desde o último envelhecimento
+
+    /* Misses em curso (poucos ao mesmo tempo: lista simples) */
+    pthread_mutex_t flight_lock;
+    pthread_cond_t flight_done;     // broadcast quando um líder termina
+    cache_flight_t* flights;
+
+    /* Caminhos que deram 404 há pouco: respondidos sem open() até expirarem
+       ou o inotify ver o ficheiro aparecer */
+    pthread_mutex_t negative_lock;
+    cache_negative_t* negative;     // NEGATIVE_SLOTS slots
+
+    /* contadores para afinação (CACHE_SHARDS / CACHE_SIZE_MB) */
+    atomic_long hits;
+    atomic_long misses;
+    atomic_long evictions;
+    atomic_long coalesced;          // misses servidos pela leitura de outro thread
+    atomic_long rejected;           // ficheiros que o filtro de admissão não deixou entrar
+    atomic_long invalidated;        // entradas retiradas porque o ficheiro mudou
+    atomic_long negative_hits;      // pedidos a ficheiros inexistentes respondidos sem ir ao disco
+} cache_shard_t;
+
 /* Estado global do cache neste processo (1 cache por processo) */
-static cache_entry_t* g_head = NULL;                            // MRU (most recently used)
-static cache_entry_t* g_tail = NULL;                            // LRU (least recently used)
-static size_t g_total_bytes = 0;                                // total de bytes atualmente no cache
-static size_t g_max_bytes = CACHE_DEFAULT_MAX_BYTES;            // limite máximo do cache
-static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;    // lock para proteger o acesso ao cache
+static cache_shard_t g_shards[CACHE_MAX_SHARDS];
+static unsigned int g_num_shards = 1;                           // potência de 2
+static size_t g_max_bytes = CACHE_DEFAULT_MAX_BYTES;            // limite máximo do cache (soma dos shards)
 static int g_initialized = 0;                                   // indica se o cache foi inicializado
+static int g_admission = 1;                                     // 1 = W-TinyLFU, 0 = só CLOCK
+static int g_use_mmap = 0;                                      // 1 = entradas são mmap() dos ficheiros
+static uint64_t g_negative_ttl_ns = 0;                          // validade de um 404 em cache (0 = desligado)
+static int g_gzip = 0;                                          // 1 = variantes gzip (cache_set_gzip)
+static atomic_long g_gzip_compressed;                           // variantes feitas pelo thread de compressão
+static atomic_long g_gzip_precompressed;                        // variantes lidas de um ".gz" ao lado
+
+static atomic_int g_rebalancing;                                // 1 enquanto um thread redistribui
+static _Atomic uint64_t g_next_rebalance_ns;
+
+/* Entradas verificadas depois deste instante são seguidas pelo inotify e não
+   precisam de stat(); UINT64_MAX enquanto o inotify não for fiável */
+static _Atomic uint64_t g_trusted_since = UINT64_MAX;
+static atomic_ulong g_invalidations;    // um load que veja isto mudar marca a entrada para revalidação
 
 // Pequena implementação de strdup para evitar warnings/portabilidade
 static char* xstrdup(const char* s) {
@@ -38,117 +171,503 @@ static char* xstrdup(const char* s) {
 }
 
 
-static void lru_move_to_front(cache_entry_t* e) {
-    if (!e || g_head == e){
-        return; // já está na frente
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/* Relógio grosseiro (resolução de alguns ms, sem syscall) para os hits que revalidam */
+static uint64_t coarse_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+static void free_entry(cache_entry_t* e) {
+    gzip_variant_t* gz = atomic_load_explicit(&e->gzip, memory_order_relaxed);
+    if (gz) {
+        free(gz->block);
+        free(gz);
     }
+    free(e->path);
+    if (e->mapped) {
+        munmap(e->data, e->size);   // as páginas continuam no page cache do kernel
+    }
+    free(e->block);
+    free(e);
+}
 
-    // Remove da posição atual
-    if (e->prev) {
-        e->prev->next = e->next;
+
+/* Larga uma referência; quem larga a última liberta a entrada (pode ser já fora de qualquer lock) */
+static void entry_unref(cache_entry_t* e) {
+    if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_acq_rel) == 1) {
+        free_entry(e);
+    }
+}
+
+
+/* Entrega ao chamador os dados de e, com uma referência nova. Com o lock do shard. */
+static void entry_hand_out(cache_entry_t* e, cache_file_t* out) {
+    atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+    out->data = e->data;
+    out->size = e->size;
+    out->mtime_ns = e->mtime_ns;
+    out->from_cache = 1;
+    out->entry = e;
+    out->content_type = e->content_type;
+    out->validators = &e->validators;
+    for (int ka = 0; ka < 2; ++ka) {
+        out->header[ka] = e->header[ka];
+        out->header_len[ka] = e->header_len[ka];
+    }
+    // Sempre escrito: out pode trazer a variante de uma entrada já largada
+    gzip_variant_t* gz = atomic_load_explicit(&e->gzip, memory_order_acquire);
+    out->gzip.data = gz ? gz->data : NULL;
+    out->gzip.size = gz ? gz->size : 0;
+    out->gzip.validators = gz ? &gz->validators : NULL;
+    for (int ka = 0; ka < 2; ++ka) {
+        out->gzip.header[ka] = gz ? gz->header[ka] : NULL;
+        out->gzip.header_len[ka] = gz ? gz->header_len[ka] : 0;
+    }
+}
+
+
+/* Insere e imediatamente antes do ponteiro: é a última entrada que o ponteiro visita */
+static void clock_insert(cache_entry_t** hand, cache_entry_t* e) {
+    if (!*hand) {
+        e->prev = e->next = e;
+        *hand = e;
+        return;
     }
-    if (e->next) {
+    e->next = *hand;
+    e->prev = (*hand)->prev;
+    (*hand)->prev->next = e;
+    (*hand)->prev = e;
+}
+
+
+static void clock_remove_entry(cache_entry_t** hand, cache_entry_t* e) {
+    if (e->next == e) {
+        *hand = NULL;       // era a única entrada
+    } else {
+        e->prev->next = e->next;
         e->next->prev = e->prev;
+        if (*hand == e) *hand = e->next;
     }
-    if (g_tail == e) {
-        g_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+
+/* Anel onde e está (janela ou espaço principal) */
+static cache_entry_t** ring_of(cache_shard_t* s, cache_entry_t* e) {
+    return e->in_window ? &s->window_hand : &s->hand;
+}
+
+
+/* FNV-1a de 64 bits, com a mistura final do MurmurHash3: sem ela, caminhos que
+   só diferem nos últimos caracteres ("f1".."f700") quase não mudam os bits altos
+   e caem todos no mesmo shard */
+static uint64_t hash_path(const char* s) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
     }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
+/* Os bits altos escolhem o shard; os baixos ficam para o índice dentro do shard */
+static cache_shard_t* shard_for(uint64_t hash) {
+    return &g_shards[(hash >> 32) & (g_num_shards - 1)];
+}
+
 
-    // colocar na frente
-    e->prev = NULL;
-    e->next = g_head;
-    if (g_head) {
-        g_head->prev = e;
+static cache_negative_t* negative_slot(cache_shard_t* s, uint64_t hash) {
+    return &s->negative[(hash >> 48) & (NEGATIVE_SLOTS - 1)];   // bits que o shard e o índice não usam
+}
+
+
+static void negative_free(cache_negative_t* n) {
+    free(n->path);
+    n->path = NULL;
+    n->expires_ns = 0;
+}
+
+
+/* Procura uma entrada pelo caminho. Espera-se que o lock do shard já esteja adquirido. */
+static cache_entry_t* find_entry(cache_shard_t* s, const char* full_path, uint64_t hash)
+{
+    if (!s->index) return NULL;
+
+    size_t mask = s->index_cap - 1;
+    for (size_t i = hash & mask; s->index[i] != NULL; i = (i + 1) & mask) {
+        cache_entry_t* e = s->index[i];
+        if (e->hash == hash && strcmp(e->path, full_path) == 0) {
+            return e;
+        }
     }
-    g_head = e;
-    if (!g_tail) {
-        g_tail = e;
+    return NULL;
+}
+
+
+/* Coloca e no primeiro slot livre da sua sequência de probing (sem verificar duplicados) */
+static void index_place(cache_entry_t** slots, size_t cap, cache_entry_t* e) {
+    size_t mask = cap - 1;
+    size_t i = e->hash & mask;
+    while (slots[i] != NULL) {
+        i = (i + 1) & mask;
     }
+    slots[i] = e;
 }
 
 
-static void lru_insert_front(cache_entry_t* e) {
-    e->prev = NULL;
-    e->next = g_head;
-    if (g_head) {
-        g_head->prev = e;
+/* Duplica o número de slots e volta a distribuir as entradas. Retorna 0 ou -1. */
+static int index_grow(cache_shard_t* s) {
+    size_t new_cap = s->index_cap ? s->index_cap * 2 : INDEX_INITIAL_CAPACITY;
+    cache_entry_t** slots = calloc(new_cap, sizeof(*slots));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < s->index_cap; ++i) {
+        if (s->index[i]) index_place(slots, new_cap, s->index[i]);
     }
-    g_head = e;
-    if (!g_tail) {
-        g_tail = e;
+    free(s->index);
+    s->index = slots;
+    s->index_cap = new_cap;
+    return 0;
+}
+
+
+static int index_insert(cache_shard_t* s, cache_entry_t* e) {
+    if ((s->index_count + 1) * 2 > s->index_cap && index_grow(s) < 0) {
+        // Sem memória para crescer: continuar enquanto houver pelo menos um slot livre
+        if (s->index_count + 1 >= s->index_cap) return -1;
     }
+    index_place(s->index, s->index_cap, e);
+    s->index_count++;
+    return 0;
 }
 
 
-static void lru_remove_entry(cache_entry_t* e) {
-    if (!e) return;
+/* Remove e do índice com backward-shift: as entradas seguintes da mesma
+   sequência recuam, por isso não são precisas tombstones. */
+static void index_remove(cache_shard_t* s, cache_entry_t* e) {
+    if (!s->index) return;
 
-    if (e->prev) {
-        e->prev->next = e->next;
+    size_t mask = s->index_cap - 1;
+    size_t i = e->hash & mask;
+    while (s->index[i] != e) {
+        if (s->index[i] == NULL) return;   // não está no índice
+        i = (i + 1) & mask;
     }
-    if (e->next) {
-        e->next->prev = e->prev;
+
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; s->index[j] != NULL; j = (j + 1) & mask) {
+        size_t home = s->index[j]->hash & mask;
+        // j pode ocupar o buraco se a sua posição ideal não estiver em ]hole, j]
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            s->index[hole] = s->index[j];
+            hole = j;
+        }
     }
+    s->index[hole] = NULL;
+    s->index_count--;
+}
+
+
+/* Mistura o hash do caminho (os bits que escolhem o shard são iguais dentro dele);
+   cada linha do sketch usa 16 bits diferentes do resultado */
+static uint64_t sketch_mix(uint64_t hash) {
+    return hash * 0x9E3779B97F4A7C15ULL;
+}
 
-    if (g_head == e) {
-        g_head = e->next;
+static size_t sketch_slot(uint64_t mixed, int row) {
+    return (size_t)row * SKETCH_WIDTH + ((mixed >> (16 * row)) & (SKETCH_WIDTH - 1));
+}
+
+
+/* Conta um acesso a hash. Pode ser chamado só com o RDLOCK. */
+static void sketch_increment(cache_shard_t* s, uint64_t hash) {
+    uint64_t mixed = sketch_mix(hash);
+    int added = 0;
+    for (int row = 0; row < SKETCH_DEPTH; ++row) {
+        atomic_uchar* c = &s->sketch[sketch_slot(mixed, row)];
+        unsigned char v = atomic_load_explicit(c, memory_order_relaxed);
+        if (v < SKETCH_MAX) {
+            atomic_store_explicit(c, v + 1, memory_order_relaxed);
+            added = 1;
+        }
     }
-    if (g_tail == e) {
-        g_tail = e->prev;
+    // Ficheiros quentes saturam e deixam de escrever no sketch
+    if (!added) return;
+
+    /* Envelhecimento: a cada SKETCH_SAMPLE incrementos todos os contadores
+       passam a metade, para a popularidade antiga ir sendo esquecida */
+    if (atomic_fetch_add_explicit(&s->sketch_additions, 1, memory_order_relaxed) + 1 == SKETCH_SAMPLE) {
+        for (size_t i = 0; i < (size_t)SKETCH_DEPTH * SKETCH_WIDTH; ++i) {
+            unsigned char v = atomic_load_explicit(&s->sketch[i], memory_order_relaxed);
+            atomic_store_explicit(&s->sketch[i], v >> 1, memory_order_relaxed);
+        }
+        atomic_store_explicit(&s->sketch_additions, 0, memory_order_relaxed);
     }
 }
 
 
-/* liberar espaço quando o cache está cheio. */
-static void lru_evict_tail(void) {
-    if (!g_tail) return;
-    
-    cache_entry_t* tail = g_tail;
+/* Frequência estimada de hash (mínimo das linhas: nunca subestima) */
+static unsigned int sketch_estimate(cache_shard_t* s, uint64_t hash) {
+    uint64_t mixed = sketch_mix(hash);
+    unsigned int min = SKETCH_MAX;
+    for (int row = 0; row < SKETCH_DEPTH; ++row) {
+        unsigned int v = atomic_load_explicit(&s->sketch[sketch_slot(mixed, row)], memory_order_relaxed);
+        if (v < min) min = v;
+    }
+    return min;
+}
+
+
+/**
+ * Escolhe a próxima vítima de um anel (algoritmo CLOCK / second chance).
+ *
+ * O ponteiro percorre o anel: entradas com o bit de referência ligado (usadas
+ * desde a última passagem) perdem o bit e ficam; devolve a primeira sem bit,
+ * sem a remover. Termina no máximo numa volta e meia. Com o WRLOCK do shard.
+ */
+static cache_entry_t* clock_select(cache_entry_t** hand) {
+    while (*hand) {
+        cache_entry_t* e = *hand;
+        if (atomic_exchange_explicit(&e->referenced, 0, memory_order_relaxed)) {
+            *hand = e->next;
+            continue;
+        }
+        return e;
+    }
+    return NULL;
+}
+
 
-    lru_remove_entry(tail);
-    if (g_total_bytes >= tail->size) {
-        g_total_bytes -= tail->size;
+/**
+ * Tira e do índice e do anel (o espaço conta logo como livre). A referência
+ * do cache passa para o chamador: a memória só é libertada quando o último
+ * pedido que a está a enviar a largar.
+ */
+static void shard_remove_entry(cache_shard_t* s, cache_entry_t* e) {
+    clock_remove_entry(ring_of(s, e), e);
+    index_remove(s, e);
+    if (e->in_window) s->window_bytes -= e->bytes;
+    if (s->total_bytes >= e->bytes) {
+        s->total_bytes -= e->bytes;
     } else {
-        g_total_bytes = 0;
+        s->total_bytes = 0;
     }
+}
 
-    free(tail->path);
-    free(tail->data);
-    free(tail);
+
+/* Despeja e do shard para dar espaço */
+static void evict_entry(cache_shard_t* s, cache_entry_t* e) {
+    shard_remove_entry(s, e);
+    s->pressure_bytes += e->bytes;
+    atomic_fetch_add_explicit(&s->evictions, 1, memory_order_relaxed);
+
+    entry_unref(e);
 }
 
 
-/* Procura uma entrada pelo caminho. Espera-se que o lock já esteja adquirido. */
-static cache_entry_t* find_entry(const char* full_path)
-{
-    for (cache_entry_t* e = g_head; e != NULL; e = e->next) {
-        if (strcmp(e->path, full_path) == 0) {
-            return e;
+/**
+ * Repõe os limites do shard (W-TinyLFU). Espera-se o WRLOCK adquirido.
+ *
+ * Ficheiros novos entram sempre na janela (um pequeno CLOCK com 1% do
+ * orçamento), para rajadas recentes terem hits. O que sai da janela é um
+ * candidato ao espaço principal: se ainda há espaço entra; senão só entra se
+ * o sketch o estimar mais frequente do que a vítima do CLOCK principal, que
+ * é despejada no lugar dele. Assim um crawler que percorre milhares de
+ * ficheiros frios (vistos uma vez) não expulsa os ficheiros populares.
+ *
+ * Com a admissão desligada a janela tem 0 bytes e o candidato entra sempre:
+ * fica o CLOCK simples.
+ */
+static void shard_make_room(cache_shard_t* s) {
+    size_t window_max = g_admission ? s->max_bytes * WINDOW_PERCENT / 100 : 0;
+
+    while (s->window_bytes > window_max || s->total_bytes > s->max_bytes) {
+        cache_entry_t* cand = clock_select(&s->window_hand);
+        if (!cand) {
+            // Janela vazia e shard ainda cheio (orçamento reduzido): despejar do principal
+            cache_entry_t* victim = clock_select(&s->hand);
+            if (!victim) return;
+            evict_entry(s, victim);
+            continue;
+        }
+
+        int admit = 1;
+        while (s->total_bytes > s->max_bytes) {
+            cache_entry_t* victim = clock_select(&s->hand);
+            if (!victim) break;
+            if (g_admission && sketch_estimate(s, cand->hash) <= sketch_estimate(s, victim->hash)) {
+                admit = 0;      // a vítima é pelo menos tão popular: fica ela
+                break;
+            }
+            evict_entry(s, victim);
         }
+
+        if (!admit || s->total_bytes > s->max_bytes) {
+            atomic_fetch_add_explicit(&s->rejected, 1, memory_order_relaxed);
+            evict_entry(s, cand);
+            continue;
+        }
+
+        // Passa da janela para o espaço principal (o total não muda)
+        clock_remove_entry(&s->window_hand, cand);
+        s->window_bytes -= cand->bytes;
+        cand->in_window = 0;
+        clock_insert(&s->hand, cand);
     }
-    return NULL;
+}
+
+
+/* Define um novo orçamento para o shard, despejando o que passar do limite */
+static void shard_set_budget(cache_shard_t* s, size_t budget) {
+    pthread_rwlock_wrlock(&s->lock);
+    s->max_bytes = budget;
+    shard_make_room(s);
+    pthread_rwlock_unlock(&s->lock);
+}
+
+
+/**
+ * Redistribui o orçamento global pelos shards conforme a procura de cada um
+ * (bytes em uso + bytes despejados/recusados desde a última vez). Se nenhum
+ * shard teve de despejar, os orçamentos atuais chegam e nada muda.
+ *
+ * Cada shard fica com pelo menos metade da sua parte igual; a outra metade do
+ * orçamento é dividida em proporção à procura, para um shard quente não ficar
+ * limitado a 1/N do cache enquanto outros estão vazios. Os shards que perdem
+ * orçamento são reduzidos primeiro, para a soma nunca passar de g_max_bytes.
+ */
+static void rebalance_shards(void) {
+    size_t demand[CACHE_MAX_SHARDS];
+    size_t current[CACHE_MAX_SHARDS];   // orçamentos lidos com o lock (só este thread os muda)
+    double total_demand = 0;
+    size_t total_pressure = 0;
+
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        cache_shard_t* s = &g_shards[i];
+        pthread_rwlock_wrlock(&s->lock);
+        demand[i] = s->total_bytes + s->pressure_bytes;
+        current[i] = s->max_bytes;
+        total_pressure += s->pressure_bytes;
+        s->pressure_bytes = 0;
+        pthread_rwlock_unlock(&s->lock);
+        total_demand += (double)demand[i];
+    }
+    if (total_pressure == 0 || total_demand <= 0) return;
+
+    size_t floor_bytes = g_max_bytes / (2 * g_num_shards);
+    size_t shared_bytes = g_max_bytes - floor_bytes * g_num_shards;
+
+    size_t budget[CACHE_MAX_SHARDS];
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        budget[i] = floor_bytes + (size_t)((double)shared_bytes * (double)demand[i] / total_demand);
+    }
+
+    // 1º os que encolhem, depois os que crescem
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        if (budget[i] < current[i]) shard_set_budget(&g_shards[i], budget[i]);
+    }
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        if (budget[i] > current[i]) shard_set_budget(&g_shards[i], budget[i]);
+    }
+}
+
+
+/* Chamado depois de inserções: no máximo um thread de cada vez, 1x por intervalo */
+static void maybe_rebalance(void) {
+    if (g_num_shards == 1) return;
+
+    uint64_t now = now_ns();
+    if (now < atomic_load_explicit(&g_next_rebalance_ns, memory_order_relaxed)) return;
+    if (atomic_exchange_explicit(&g_rebalancing, 1, memory_order_acquire)) return;
+
+    atomic_store_explicit(&g_next_rebalance_ns, now + REBALANCE_INTERVAL_NS, memory_order_relaxed);
+    rebalance_shards();
+    atomic_store_explicit(&g_rebalancing, 0, memory_order_release);
+}
+
+
+static int64_t stat_mtime_ns(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+/* 1 se o ficheiro no disco ainda é o que f tem (mesmo mtime e tamanho) */
+static int file_unchanged(const char* full_path, const cache_file_t* f) {
+    struct stat st;
+    return stat(full_path, &st) == 0 && S_ISREG(st.st_mode) &&
+           (size_t)st.st_size == f->size && stat_mtime_ns(&st) == f->mtime_ns;
+}
+
+
+/* Entradas verificadas antes do instante devolvido têm de ser confirmadas com stat() */
+static uint64_t revalidate_before(uint64_t now) {
+    uint64_t trusted = atomic_load_explicit(&g_trusted_since, memory_order_relaxed);
+    uint64_t stale = now > REVALIDATE_INTERVAL_NS ? now - REVALIDATE_INTERVAL_NS : 0;
+    return trusted < stale ? trusted : stale;
 }
 
 
 /**
- * Lê um ficheiro inteiro para um buffer alocado em memória (malloc).
- * 
+ * Chave canónica: "www//a.css" e "www/./a.css" são o mesmo ficheiro que
+ * "www/a.css" (a única forma que o inotify conhece). Devolve path se já for
+ * canónico, senão a versão simplificada em buf.
+ */
+static const char* canonical_path(const char* path, char* buf, size_t size) {
+    if (!strstr(path, "//") && !strstr(path, "/./")) return path;
+    if (strlen(path) >= size) return path;
+
+    char* o = buf;
+    for (const char* p = path; *p != '\0'; ) {
+        if (*p == '/' && o > buf) {
+            if (o[-1] == '/') {             // barra repetida
+                p++;
+                continue;
+            }
+            if (p[1] == '.' && (p[2] == '/' || p[2] == '\0')) {   // segmento "."
+                p += 2;
+                continue;
+            }
+        }
+        *o++ = *p++;
+    }
+    *o = '\0';
+    return buf;
+}
+
+
+/**
+ * Abre um ficheiro regular para leitura e obtém o seu tamanho.
+ *
  * Argumentos:
- *   full_path  - caminho completo do ficheiro a ler
- *   buf_out    - ponteiro para guardar o endereço do buffer alocado
- *   size_out   - ponteiro para guardar o tamanho do ficheiro (em bytes)
- * 
+ *   full_path  - caminho completo do ficheiro
+ *   st_out     - stat do ficheiro aberto (tamanho, mtime, inode)
+ *
  * Retorna:
- *   0 em sucesso (buffer preenchido e tamanho definido)
- *   -1 em erro (ficheiro não existe, não é leitura, sem memória, etc.)
+ *   fd >= 0 em sucesso
+ *   -1 em erro (ficheiro não existe, não é um ficheiro regular, etc.)
  */
-static int read_file_fully(const char* full_path, char** buf_out, size_t* size_out) {
+static int open_regular_file(const char* full_path, struct stat* st_out) {
     // Abrir o ficheiro para leitura (O_RDONLY = read-only)
     int fd = open(full_path, O_RDONLY);
     if (fd < 0) {
         return -1;
     }
-    
+
     // Obter informações do ficheiro (tamanho, tipo, permissões)
     struct stat st;
     if (fstat(fd, &st) < 0) {
@@ -159,81 +678,281 @@ static int read_file_fully(const char* full_path, char** buf_out, size_t* size_o
     // Verificar que é realmente um ficheiro regular (não diretório, symlink, etc.)
     if (!S_ISREG(st.st_mode)) {
         close(fd);
+        errno = EINVAL;  // existe, mas não é servível (não vai para o cache negativo)
         return -1;
     }
 
     // Obter tamanho do ficheiro
-    off_t fsize = st.st_size;
-    if (fsize < 0) {
+    if (st.st_size < 0) {
         close(fd);
         errno = EIO;  // erro de I/O
         return -1;
     }
 
-    // Caso especial - ficheiro vazio
-    if (fsize == 0) {
-        // Ficheiro vazio -> alocar 1 byte (para evitar malloc(0)) e retornar tamanho 0
-        char* buf = malloc(1);
-        if (!buf) {
-            close(fd);
-            return -1;
-        }
-        *buf_out = buf;     // guarda endereço do buffer
-        *size_out = 0;      // tamanho real é 0
-        close(fd);
-        return 0;
-    }
+    *st_out = st;
+    return fd;
+}
 
-    // Alocar buffer com exatamente o tamanho do ficheiro
-    char* buf = malloc((size_t)fsize);
-    if (!buf) {
-        close(fd);
+
+/**
+ * Lê um ficheiro já aberto inteiro para um buffer alocado em memória (malloc).
+ * Não fecha o fd.
+ *
+ * Argumentos:
+ *   fd         - ficheiro aberto (open_regular_file)
+ *   fsize      - tamanho do ficheiro
+ *   reserve    - bytes livres à frente dos dados (os dados começam em buf + reserve)
+ *   buf_out    - ponteiro para guardar o endereço do buffer alocado
+ *   size_out   - ponteiro para guardar o número de bytes lidos
+ *
+ * Retorna:
+ *   0 em sucesso (buffer preenchido e tamanho definido)
+ *   -1 em erro (erro de leitura, sem memória, etc.)
+ */
+static int read_file_fully(int fd, size_t fsize, size_t reserve, char** buf_out, size_t* size_out) {
+    // Ficheiro vazio -> alocar 1 byte (para evitar malloc(0)) e retornar tamanho 0
+    char* base = malloc(reserve + fsize > 0 ? reserve + fsize : 1);
+    if (!base) {
         return -1;
     }
+    char* buf = base + reserve;
 
     // Ler o ficheiro em pedaços (loop, porque read() pode ler menos bytes que pedido)
-    size_t to_read = (size_t)fsize;        // total de bytes a ler
     size_t total_read = 0;                 // bytes já lidos
-    while (total_read < to_read) {
-        // Ler até (to_read - total_read) bytes a partir da posição total_read
-        ssize_t n = read(fd, buf + total_read, to_read - total_read);
-        
+    while (total_read < fsize) {
+        // Ler até (fsize - total_read) bytes a partir da posição total_read
+        ssize_t n = read(fd, buf + total_read, fsize - total_read);
+
         if (n < 0) {
             if (errno == EINTR) {
                 continue;
             }
             // Erro real (permissão, disco corrompido, etc.)
-            free(buf);
-            close(fd);
+            free(base);
             return -1;
         }
-        
+
         if (n == 0) {
             break;
         }
-        
+
         // Avançar contador de bytes lidos
         total_read += (size_t)n;
     }
 
-    close(fd);
-
-    *buf_out = buf;           // guarda endereço do buffer alocado
+    *buf_out = base;          // guarda endereço do buffer alocado
     *size_out = total_read;   // guarda tamanho real lido
-    
+
     return 0;
 }
 
 
-int cache_init(long max_bytes) {
+/**
+ * Mapeia o ficheiro só para leitura (CACHE_MMAP=1): os dados ficam apenas no
+ * page cache, sem cópia no heap. MAP_POPULATE carrega já as páginas, para o
+ * envio não ter page faults. Retorna NULL se não for possível (usa-se read()).
+ */
+static char* map_file(int fd, size_t fsize) {
+    void* p = mmap(NULL, fsize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(p, fsize, MADV_WILLNEED);   // manter as páginas quentes (a entrada vai ser reenviada)
+    return p;
+}
+
+
+/* Formata os headers 200 de um corpo em [start, end[: o de keep-alive acaba em
+   end (mesmo antes do corpo, se está no mesmo bloco: um só buffer a enviar) e o
+   de close fica antes dele. Se não couberem, retorna -1 e fica sem headers. */
+static int build_headers(char* header[2], size_t header_len[2], char* start, char* end,
+                         const char* content_type, const char* content_encoding,
+                         const http_validators_t* validators, size_t body_len) {
+    char tmp[RESPONSE_HEADER_MAX];
+    for (int ka = 1; ka >= 0; --ka) {
+        int n = http_format_header(tmp, sizeof(tmp), 200, "OK", content_type,
+                                   content_encoding, validators, body_len, ka);
+        if (n < 0 || (size_t)n >= sizeof(tmp) || end - start < n) {
+            header[0] = header[1] = NULL;
+            header_len[0] = header_len[1] = 0;
+            return -1;
+        }
+        end -= n;
+        memcpy(end, tmp, (size_t)n);
+        header[ka] = end;
+        header_len[ka] = (size_t)n;
+    }
+    return 0;
+}
+
+
+/* Lê (ou mapeia, com CACHE_MMAP) o ficheiro aberto para uma entrada nova, já
+   com as respostas 200 pré-formatadas. Ainda não está em nenhum shard. */
+static cache_entry_t* entry_create(const char* full_path, uint64_t hash, int fd,
+                                   size_t fsize, int64_t mtime, const char* content_type,
+                                   const http_validators_t* validators) {
+    cache_entry_t* e = malloc(sizeof(cache_entry_t));
+    if (!e) return NULL;
+
+    e->path = xstrdup(full_path);
+    if (!e->path) {
+        free(e);
+        return NULL;
+    }
+
+    e->data = NULL;
+    e->block = NULL;
+    e->mapped = 0;
+    if (g_use_mmap && fsize > 0) {
+        e->data = map_file(fd, fsize);
+        e->mapped = (e->data != NULL);
+    }
+    if (e->mapped) {
+        e->size = fsize;
+        e->block = malloc(RESPONSE_RESERVE);       // só os headers (sem eles formata-se no envio)
+    } else if (read_file_fully(fd, fsize, RESPONSE_RESERVE, &e->block, &e->size) == 0) {
+        e->data = e->block + RESPONSE_RESERVE;
+    } else {
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+
+    e->content_type = content_type;
+    e->validators = *validators;
+    e->header[0] = e->header[1] = NULL;
+    e->header_len[0] = e->header_len[1] = 0;
+    if (e->block) {
+        build_headers(e->header, e->header_len, e->block, e->block + RESPONSE_RESERVE,
+                      e->content_type, NULL, &e->validators, e->size);
+    }
+    e->bytes = e->size;
+    e->compressible = validators->vary_encoding;
+    atomic_init(&e->gzip, NULL);
+
+    e->hash = hash;
+    atomic_init(&e->referenced, 0);
+    atomic_init(&e->refs, 1);       // referência do próprio cache
+    e->in_window = 1;
+    e->mtime_ns = mtime;
+    atomic_init(&e->verified_ns, 0);
+    e->prev = e->next = NULL;
+    return e;
+}
+
+
+/* Variante gzip de e com o corpo comprimido em block (já com RESPONSE_RESERVE
+   à frente, que passa a ser dela). Em erro liberta block e retorna NULL. */
+static gzip_variant_t* variant_create(const cache_entry_t* e, char* block, size_t size) {
+    gzip_variant_t* gz = malloc(sizeof(gzip_variant_t));
+    if (!gz) {
+        free(block);
+        return NULL;
+    }
+    gz->block = block;
+    gz->data = block + RESPONSE_RESERVE;
+    gz->size = size;
+
+    // Bytes diferentes => ETag diferente: "<etag>-gz" (o 304 compara a que o cliente tem)
+    gz->validators = e->validators;
+    int len = (int)strlen(e->validators.etag);
+    int n = snprintf(gz->validators.etag, sizeof(gz->validators.etag), "%.*s-gz\"",
+                     len - 1, e->validators.etag);
+    if (len < 2 || n < 0 || (size_t)n >= sizeof(gz->validators.etag) ||
+        build_headers(gz->header, gz->header_len, block, gz->data, e->content_type, "gzip",
+                      &gz->validators, size) < 0) {
+        free(block);
+        free(gz);
+        return NULL;
+    }
+    return gz;
+}
+
+
+/* Variante a partir de "<ficheiro>.gz" no disco (comprimido no deploy), se é
+   pelo menos tão recente como o original e mais pequeno. NULL se não há. */
+static gzip_variant_t* variant_from_sibling(const cache_entry_t* e) {
+    char gz_path[CANONICAL_PATH_MAX];
+    int n = snprintf(gz_path, sizeof(gz_path), "%s.gz", e->path);
+    if (n < 0 || (size_t)n >= sizeof(gz_path)) return NULL;
+
+    struct stat st;
+    int fd = open_regular_file(gz_path, &st);
+    if (fd < 0) return NULL;
+
+    gzip_variant_t* gz = NULL;
+    char* block;
+    size_t size;
+    if (stat_mtime_ns(&st) >= e->mtime_ns && (size_t)st.st_size < e->size &&
+        read_file_fully(fd, (size_t)st.st_size, RESPONSE_RESERVE, &block, &size) == 0) {
+        gz = variant_create(e, block, size);
+    }
+    close(fd);
+    return gz;
+}
+
+
+/* Junta gz a e, que está no shard s (com o WRLOCK): passa a contar no orçamento */
+static void variant_attach(cache_shard_t* s, cache_entry_t* e, gzip_variant_t* gz) {
+    e->bytes += gz->size;
+    if (e->in_window) s->window_bytes += gz->size;
+    s->total_bytes += gz->size;
+    atomic_store_explicit(&e->gzip, gz, memory_order_release);
+}
+
+
+int cache_init(long max_bytes, int shards, int admission, int use_mmap) {
     if (max_bytes > 0) {
         g_max_bytes = (size_t)max_bytes;
     } else {
         g_max_bytes = CACHE_DEFAULT_MAX_BYTES;
     }
 
-    g_head = g_tail = NULL;
-    g_total_bytes = 0;
+    g_admission = admission ? 1 : 0;
+    g_use_mmap = use_mmap ? 1 : 0;
+    atomic_store(&g_trusted_since, UINT64_MAX);     // até cache_watch_start() ter sucesso
+
+    // Nº de shards: potência de 2 (o shard sai de uma máscara do hash)
+    if (shards <= 0) shards = CACHE_DEFAULT_SHARDS;
+    if (shards > CACHE_MAX_SHARDS) shards = CACHE_MAX_SHARDS;
+    g_num_shards = 1;
+    while (g_num_shards < (unsigned int)shards) {
+        g_num_shards <<= 1;
+    }
+
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        cache_shard_t* s = &g_shards[i];
+        memset(s, 0, sizeof(*s));
+        s->sketch = calloc((size_t)SKETCH_DEPTH * SKETCH_WIDTH, sizeof(*s->sketch));
+        if (!s->sketch || pthread_rwlock_init(&s->lock, NULL) != 0 || index_grow(s) < 0 ||
+            pthread_mutex_init(&s->flight_lock, NULL) != 0 ||
+            pthread_cond_init(&s->flight_done, NULL) != 0 ||
+            pthread_mutex_init(&s->negative_lock, NULL) != 0 ||
+            !(s->negative = calloc(NEGATIVE_SLOTS, sizeof(*s->negative)))) {
+            perror("cache_init");
+            for (unsigned int j = 0; j <= i; ++j) {
+                free(g_shards[j].index);
+                g_shards[j].index = NULL;
+                free(g_shards[j].sketch);
+                g_shards[j].sketch = NULL;
+                free(g_shards[j].negative);
+                g_shards[j].negative = NULL;
+            }
+            return -1;
+        }
+        s->max_bytes = g_max_bytes / g_num_shards;   // começa dividido por igual
+        atomic_init(&s->hits, 0);
+        atomic_init(&s->misses, 0);
+        atomic_init(&s->evictions, 0);
+        atomic_init(&s->coalesced, 0);
+        atomic_init(&s->rejected, 0);
+        atomic_init(&s->invalidated, 0);
+        atomic_init(&s->negative_hits, 0);
+        atomic_init(&s->sketch_additions, 0);
+    }
+
+    atomic_init(&g_rebalancing, 0);
+    atomic_init(&g_next_rebalance_ns, now_ns() + REBALANCE_INTERVAL_NS);
     g_initialized = 1;
 
     return 0;
@@ -243,152 +962,727 @@ int cache_init(long max_bytes) {
 void cache_destroy(void) {
     if (!g_initialized) return;
 
-    pthread_rwlock_wrlock(&g_lock);
+    cache_gzip_stop();      // o compressor e o thread do inotify mexem nos shards
+    cache_watch_stop();
+    cache_fd_destroy();
 
-    cache_entry_t* e = g_head;
-    while (e) {
-        cache_entry_t* next = e->next;
-        free(e->path);
-        free(e->data);
-        free(e);
-        e = next;
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        cache_shard_t* s = &g_shards[i];
+        pthread_rwlock_wrlock(&s->lock);
+
+        cache_entry_t** rings[] = { &s->window_hand, &s->hand };
+        for (int r = 0; r < 2; ++r) {
+            while (*rings[r]) {
+                cache_entry_t* e = *rings[r];
+                clock_remove_entry(rings[r], e);
+                entry_unref(e);
+            }
+        }
+        s->total_bytes = s->window_bytes = 0;
+
+        free(s->index);
+        s->index = NULL;
+        free(s->sketch);
+        s->sketch = NULL;
+        s->index_cap = s->index_count = 0;
+
+        pthread_rwlock_unlock(&s->lock);
+        pthread_rwlock_destroy(&s->lock);
+        pthread_mutex_destroy(&s->flight_lock);
+        pthread_cond_destroy(&s->flight_done);
+
+        for (int i = 0; i < NEGATIVE_SLOTS; ++i) {
+            negative_free(&s->negative[i]);
+        }
+        free(s->negative);
+        s->negative = NULL;
+        pthread_mutex_destroy(&s->negative_lock);
     }
 
-    g_head = g_tail = NULL;
-    g_total_bytes = 0;
+    g_gzip = 0;
     g_initialized = 0;
+}
 
-    pthread_rwlock_unlock(&g_lock);
+
+/* Retira e do shard se ainda lá estiver (o ficheiro mudou). O chamador tem uma referência. */
+static void invalidate_entry(cache_shard_t* s, cache_entry_t* e) {
+    pthread_rwlock_wrlock(&s->lock);
+    int found = find_entry(s, e->path, e->hash) == e;
+    if (found) {
+        shard_remove_entry(s, e);
+        atomic_fetch_add_explicit(&s->invalidated, 1, memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(&s->lock);
+    if (found) entry_unref(e);
+}
+
+
+/* Procura no cache (partilhado ou deste processo). Em hit preenche out e retorna 1.
+   count = 1 conta o hit (o resultado de uma procura falhada conta o chamador com
+   count_result(), depois de excluir o cache negativo); 0 para procuras repetidas. */
+static int cache_lookup(cache_shard_t* s, const char* full_path, uint64_t hash,
+                        cache_file_t* out, int count) {
+    int recheck = 0;
+
+    if (cache_shm_enabled()) {
+        uint64_t now = coarse_now_ns();
+        int r = cache_shm_lookup(full_path, hash, revalidate_before(now), now, out, count);
+        if (r == 0) return 0;
+        recheck = (r == 2);
+    } else {
+        /* Tenta encontrar a entrada com lock de leitura (múltiplos leitores permitidos) */
+        pthread_rwlock_rdlock(&s->lock);
+        cache_entry_t* e = find_entry(s, full_path, hash);
+        if (!e) {
+            pthread_rwlock_unlock(&s->lock);
+            return 0;
+        }
+        if (count && g_admission) sketch_increment(s, hash);   // cada pedido conta, hit ou miss
+        // Evitar escrever a cache line se o bit já estiver ligado (hot files)
+        if (!atomic_load_explicit(&e->referenced, memory_order_relaxed)) {
+            atomic_store_explicit(&e->referenced, 1, memory_order_relaxed);
+        }
+        entry_hand_out(e, out);  // a referência protege data de uma evicção concorrente
+
+        // Sem inotify fiável: só um pedido por intervalo confirma a entrada no disco
+        uint64_t verified = atomic_load_explicit(&e->verified_ns, memory_order_relaxed);
+        if (verified < atomic_load_explicit(&g_trusted_since, memory_order_relaxed)) {
+            uint64_t now = coarse_now_ns();
+            recheck = verified < revalidate_before(now) &&
+                      atomic_compare_exchange_strong_explicit(&e->verified_ns, &verified, now,
+                                                              memory_order_relaxed,
+                                                              memory_order_relaxed);
+        }
+        pthread_rwlock_unlock(&s->lock);
+        if (count) atomic_fetch_add_explicit(&s->hits, 1, memory_order_relaxed);
+    }
+
+    if (recheck && !file_unchanged(full_path, out)) {
+        // Mudou sem o inotify dar conta: a entrada deixa de servir e o pedido é um miss
+        if (out->entry) {
+            invalidate_entry(s, out->entry);
+        } else {
+            cache_shm_invalidate(full_path, hash);
+        }
+        cache_release_file(out);
+        out->size = 0;
+        out->mtime_ns = 0;
+        out->from_cache = 0;
+        return 0;
+    }
+
+    out->is_hit = 1;
+    return 1;
+}
+
+
+/* Um pedido que falhou a 1ª procura e não veio do cache negativo conta no
+   sketch antes de carregar (a admissão da entrada nova já o vê) */
+static void sketch_touch(cache_shard_t* s, uint64_t hash) {
+    if (cache_shm_enabled() || !g_admission) return;
+    pthread_rwlock_rdlock(&s->lock);
+    sketch_increment(s, hash);
+    pthread_rwlock_unlock(&s->lock);
+}
+
+
+/* Conta o resultado desse pedido uma só vez, como o worker (out->is_hit):
+   quem esperou pelo líder (coalesced) ou perdeu a corrida na inserção é um hit */
+static void count_result(cache_shard_t* s, uint64_t hash, int hit) {
+    if (cache_shm_enabled()) {
+        cache_shm_count(hash, hit);
+    } else {
+        atomic_fetch_add_explicit(hit ? &s->hits : &s->misses, 1, memory_order_relaxed);
+    }
 }
 
 
 /**
- * Lógica:
- *  1. RDLOCK + procura entrada.
- *     - se encontrar => hit (from_cache=1, is_hit=1)
- *  2. se não encontrar => unlock, ler ficheiro do disco.
- *     - se ficheiro > CACHE_MAX_FILE_SIZE => devolve buffer NON-cache (from_cache=0)
- *     - se ficheiro <= CACHE_MAX_FILE_SIZE => WRLOCK, volta a verificar, insere se ainda não existir.
+ * Single-flight: o primeiro thread que falha um ficheiro fica "líder" e
+ * carrega-o; os que falham o mesmo ficheiro enquanto isso esperam pelo
+ * resultado em vez de o lerem também do disco.
+ *
+ * Retorna FLIGHT_LEADER (e *lead_out) se este thread deve carregar o ficheiro
+ * e depois chamar flight_end(); caso contrário, o resultado do líder
+ * (com FLIGHT_FAILED, errno fica com o erro do líder).
  */
-int cache_get_file(const char* full_path,
-                   char** data_out,
-                   size_t* size_out,
-                   int* from_cache_out,
-                   int* is_hit_out)
-{
-    if (!g_initialized || !full_path || !data_out || !size_out) {
-        return -1;
+static int flight_begin(cache_shard_t* s, const char* full_path, uint64_t hash,
+                        cache_flight_t** lead_out) {
+    *lead_out = NULL;
+    pthread_mutex_lock(&s->flight_lock);
+
+    for (cache_flight_t* f = s->flights; f != NULL; f = f->next) {
+        if (f->hash == hash && strcmp(f->path, full_path) == 0) {
+            f->refs++;
+            while (f->status == FLIGHT_LEADER) {
+                pthread_cond_wait(&s->flight_done, &s->flight_lock);
+            }
+            int status = f->status;
+            if (status == FLIGHT_FAILED) errno = f->err;
+            if (--f->refs == 0) free(f);
+            pthread_mutex_unlock(&s->flight_lock);
+            return status;
+        }
     }
 
-    /* Flags de saída: por omissão, assumimos que não veio do cache e foi
-       um miss (is_hit = 0). Chamador pode passar NULL se não quiser esses dados. */
-    if (from_cache_out) *from_cache_out = 0;
-    if (is_hit_out) *is_hit_out = 0;
+    cache_flight_t* f = malloc(sizeof(*f));
+    if (!f) {
+        // Sem memória para coordenar: carregar sem single-flight
+        pthread_mutex_unlock(&s->flight_lock);
+        return FLIGHT_UNCACHED;
+    }
+    f->hash = hash;
+    f->path = full_path;        // válido até flight_end() (o líder ainda não retornou)
+    f->status = FLIGHT_LEADER;
+    f->err = 0;
+    f->refs = 1;
+    f->next = s->flights;
+    s->flights = f;
 
-    /* Tenta encontrar a entrada com lock de leitura (múltiplos leitores permitidos) */
-    pthread_rwlock_rdlock(&g_lock);
-    cache_entry_t* e = find_entry(full_path);
-    pthread_rwlock_unlock(&g_lock);
+    pthread_mutex_unlock(&s->flight_lock);
+    *lead_out = f;
+    return FLIGHT_LEADER;
+}
 
-    if (e) {
-        /* Upgrade para WRLOCK para atualizar LRU com segurança */
-        pthread_rwlock_wrlock(&g_lock);
-        cache_entry_t* again = find_entry(full_path);
-        if (again) {
-            lru_move_to_front(again);
-            *data_out = again->data;
-            *size_out = again->size;
-            if (from_cache_out) *from_cache_out = 1;  // veio do cache
-            if (is_hit_out) *is_hit_out = 1;          // hit
-            pthread_rwlock_unlock(&g_lock);
-            return 0;
-        }
-        pthread_rwlock_unlock(&g_lock);
-        /* Se chegou aqui, a entrada foi removida entre locks -> tratar como miss */
+
+/* O líder publica o resultado (e o errno, se falhou) e acorda quem estava à espera */
+static void flight_end(cache_shard_t* s, cache_flight_t* f, int status, int err) {
+    pthread_mutex_lock(&s->flight_lock);
+
+    cache_flight_t** pp = &s->flights;
+    while (*pp != f) {
+        pp = &(*pp)->next;
     }
+    *pp = f->next;
+
+    f->status = status;
+    f->err = err;
+    pthread_cond_broadcast(&s->flight_done);
+    if (--f->refs == 0) free(f);
+
+    pthread_mutex_unlock(&s->flight_lock);
+}
+
+
+/* 1 se full_path deu 404 há menos de NEGATIVE_CACHE_TTL_MS (e nada o criou entretanto) */
+static int negative_lookup(cache_shard_t* s, const char* full_path, uint64_t hash) {
+    if (!g_negative_ttl_ns) return 0;
+
+    uint64_t now = coarse_now_ns();
+    pthread_mutex_lock(&s->negative_lock);
+    cache_negative_t* n = negative_slot(s, hash);
+    int found = n->expires_ns > now && n->hash == hash && strcmp(n->path, full_path) == 0;
+    pthread_mutex_unlock(&s->negative_lock);
+
+    if (found) atomic_fetch_add_explicit(&s->negative_hits, 1, memory_order_relaxed);
+    return found;
+}
+
+
+/* Lembra que full_path não existe, se nenhuma invalidação aconteceu desde o open()
+   que falhou (o ficheiro pode ter sido criado entretanto). Substitui o que estiver no slot. */
+static void negative_insert(cache_shard_t* s, const char* full_path, uint64_t hash,
+                            unsigned long invalidations) {
+    if (!g_negative_ttl_ns) return;
 
-    /* Miss: ler o ficheiro do disco sem segurar o lock do cache (evita bloquear leitores) */
-    char* buf = NULL;
-    size_t fsize = 0;
-    if (read_file_fully(full_path, &buf, &fsize) < 0) {
+    char* path = xstrdup(full_path);
+    if (!path) return;
+
+    pthread_mutex_lock(&s->negative_lock);
+    if (atomic_load(&g_invalidations) != invalidations) {
+        pthread_mutex_unlock(&s->negative_lock);
+        free(path);
+        return;
+    }
+    cache_negative_t* n = negative_slot(s, hash);
+    negative_free(n);
+    n->hash = hash;
+    n->path = path;
+    n->expires_ns = coarse_now_ns() + g_negative_ttl_ns;
+    pthread_mutex_unlock(&s->negative_lock);
+}
+
+
+/* O ficheiro apareceu (inotify): esquecer o 404 */
+static void negative_clear(cache_shard_t* s, const char* full_path, uint64_t hash) {
+    pthread_mutex_lock(&s->negative_lock);
+    cache_negative_t* n = negative_slot(s, hash);
+    if (n->path && n->hash == hash && strcmp(n->path, full_path) == 0) {
+        negative_free(n);
+    }
+    pthread_mutex_unlock(&s->negative_lock);
+}
+
+
+/* Carrega o ficheiro do disco (miss) e insere-o no cache se couber */
+static int load_file(cache_shard_t* s, const char* full_path, uint64_t hash, cache_file_t* out)
+{
+    /* Se o inotify invalidar este caminho entre o open e a inserção, a entrada
+       nova fica marcada para ser confirmada com stat() no primeiro hit */
+    uint64_t started = now_ns();
+    unsigned long invalidations = atomic_load(&g_invalidations);
+
+    /* Miss: abrir o ficheiro sem segurar o lock do cache (evita bloquear leitores) */
+    struct stat st;
+    int fd = open_regular_file(full_path, &st);
+    if (fd < 0) {
+        int err = errno;
+        if (err == ENOENT || err == ENOTDIR) {
+            negative_insert(s, full_path, hash, invalidations);
+        }
+        errno = err;            // o single-flight decide pelo errno se partilha a falha
         return -1;
     }
+    size_t fsize = (size_t)st.st_size;
+    int64_t mtime = stat_mtime_ns(&st);
+    out->mtime_ns = mtime;
+
+    /* Tipo MIME resolvido aqui, uma vez: fica guardado com a entrada */
+    int mime = mime_lookup(full_path);
+    out->content_type = mime_name(mime);
+    http_validators_t validators;
+    http_format_validators(&validators, (uint64_t)st.st_ino, fsize, mtime);
 
-    /* Se o ficheiro é demasiado grande para o cache, não o inserimos:
-       devolvemos apenas o buffer lido (não encapsulado no cache). */
+    /* Ficheiro demasiado grande para o cache: não o lemos para memória.
+       O chamador envia-o com sendfile() a partir do fd; o fd fica no cache de
+       ficheiros abertos (se ligado) para os pedidos seguintes. */
     if (fsize > CACHE_MAX_FILE_SIZE) {
-        *data_out = buf;                     // buffer alocado por read_file_fully
-        *size_out = fsize;
-        if (from_cache_out) *from_cache_out = 0;
-        // is_hit_out já está a 0 (miss)
+        cache_fd_insert(full_path, hash, fd, &st, out->content_type, &validators, out);
         return 0;
     }
 
+    if (cache_shm_enabled()) {
+        // Copiado para o segmento partilhado: o buffer lido deixa de ser preciso
+        char* buf = NULL;
+        int rc = read_file_fully(fd, fsize, 0, &buf, &fsize);
+        close(fd);
+        if (rc < 0) {
+            return -1;
+        }
+        uint64_t verified = (atomic_load(&g_invalidations) == invalidations) ? started : 0;
+        if (cache_shm_insert(full_path, hash, buf, fsize, mtime, mime, &validators, verified, out)) {
+            free(buf);
+        } else {
+            out->data = buf;
+            out->size = fsize;
+            out->own_validators = validators;
+            out->validators = &out->own_validators;
+        }
+        return 0;
+    }
+
+    /* Tipos de texto: a resposta passa a depender do Accept-Encoding (variante gzip) */
+    validators.vary_encoding = g_gzip && fsize >= GZIP_MIN_SIZE &&
+                               mime_compressible(out->content_type);
+
+    /* Ler sem segurar o lock (com CACHE_MMAP a entrada é o próprio mapeamento) */
+    cache_entry_t* new_e = entry_create(full_path, hash, fd, fsize, mtime, out->content_type, &validators);
+    close(fd);
+    if (!new_e) {
+        return -1;
+    }
+
+    /* A variante gzip (de um ".gz" ao lado ou comprimida) é feita pelo thread
+       depois de inserida: o pedido não paga mais nenhum open() nem a compressão */
+    int compress = new_e->compressible;
+    fsize = new_e->bytes;
+    atomic_store(&new_e->verified_ns,
+                 atomic_load(&g_invalidations) == invalidations ? started : 0);
+
     /* Vamos inserir no cache: obter WRLOCK para exclusividade ao modificar estruturas */
-    pthread_rwlock_wrlock(&g_lock);
+    pthread_rwlock_wrlock(&s->lock);
 
     /* Entre ler do disco e adquirir o WRLOCK, outro thread pode ter inserido a mesma entrada.
        Re-verificamos para evitar duplicação e desperdício de memória. */
-    e = find_entry(full_path);
+    cache_entry_t* e = find_entry(s, full_path, hash);
     if (e) {
-        /* Já foi inserida por outro thread -> libertamos o buffer que lemos e usamos a existente */
-        free(buf);
+        /* Já foi inserida por outro thread -> usamos a existente e deitamos fora a que lemos */
+        entry_hand_out(e, out);
+        out->is_hit = 1;
 
-        *data_out = e->data;
-        *size_out = e->size;
-        if (from_cache_out) *from_cache_out = 1;
-        if (is_hit_out) *is_hit_out = 1;
+        pthread_rwlock_unlock(&s->lock);
+        free_entry(new_e);
+        return 0;
+    }
 
-        pthread_rwlock_unlock(&g_lock);
+    /* Se o ficheiro não cabe no orçamento do shard, devolvemos sem o colocar em cache
+       (conta como procura para o rebalanceamento dar mais espaço a este shard).
+       Também se o índice não tiver espaço: o pedido leva a única referência. */
+    int too_big = fsize > s->max_bytes;
+    if (too_big) {
+        s->pressure_bytes += fsize;
+    }
+    if (too_big || index_insert(s, new_e) < 0) {
+        pthread_rwlock_unlock(&s->lock);
+        entry_hand_out(new_e, out);
+        entry_unref(new_e);
+        if (too_big) maybe_rebalance();
         return 0;
     }
 
-    /* Garantir espaço suficiente: remover entradas LRU até caber o novo ficheiro */
-    while (g_total_bytes + fsize > g_max_bytes && g_tail != NULL) {
-        lru_evict_tail();
+    /* Inserir a nova entrada na janela e atualizar contadores */
+    clock_insert(&s->window_hand, new_e);
+    s->window_bytes += fsize;
+    s->total_bytes += fsize;
+    if (compress) {
+        atomic_fetch_add_explicit(&new_e->refs, 1, memory_order_relaxed);    // a da fila
     }
 
-    /* Se mesmo após evicções o ficheiro não cabe, devolvemos sem o colocar em cache */
-    if (fsize > g_max_bytes) {
-        pthread_rwlock_unlock(&g_lock);
-        *data_out = buf;
-        *size_out = fsize;
-        if (from_cache_out) *from_cache_out = 0;
+    /* Devolver ao chamador o ponteiro para os dados no cache (com a referência,
+       continua válido mesmo que o filtro de admissão a despeje já a seguir) */
+    entry_hand_out(new_e, out);
+    // is_hit mantém-se 0 porque foi miss inicialmente
+
+    /* Garantir espaço: a janela passa candidatos ao espaço principal pelo filtro de admissão */
+    shard_make_room(s);
+
+    pthread_rwlock_unlock(&s->lock);
+    if (compress && cache_gzip_enqueue(new_e) < 0) {
+        entry_unref(new_e);     // fila cheia: fica só com a versão original
+    }
+    maybe_rebalance();
+    return 0;
+}
+
+
+void cache_gzip_run(cache_entry_t* e) {
+    cache_shard_t* s = shard_for(e->hash);
+
+    // Despejada ou invalidada enquanto esperava na fila: não vale a pena comprimir
+    pthread_rwlock_rdlock(&s->lock);
+    int cached = (find_entry(s, e->path, e->hash) == e);
+    pthread_rwlock_unlock(&s->lock);
+
+    // Um ".gz" ao lado (comprimido no deploy) poupa a compressão
+    char* block;
+    size_t size;
+    gzip_variant_t* gz = cached ? variant_from_sibling(e) : NULL;
+    int precompressed = gz != NULL;
+    if (cached && !gz && cache_gzip_compress(e->data, e->size, RESPONSE_RESERVE, &block, &size) == 0) {
+        gz = variant_create(e, block, size);
+    }
+
+    if (gz) {
+        pthread_rwlock_wrlock(&s->lock);
+        if (find_entry(s, e->path, e->hash) == e) {
+            variant_attach(s, e, gz);
+            gz = NULL;
+            atomic_fetch_add_explicit(precompressed ? &g_gzip_precompressed : &g_gzip_compressed, 1,
+                                      memory_order_relaxed);
+            shard_make_room(s);
+        }
+        pthread_rwlock_unlock(&s->lock);
+        if (gz) {
+            free(gz->block);
+            free(gz);
+        }
+    }
+    entry_unref(e);
+}
+
+
+void cache_gzip_drop(cache_entry_t* e) {
+    entry_unref(e);
+}
+
+
+/* Procura depois de falhar o cache e o cache negativo: fd aberto, single-flight, disco */
+static int get_missed_file(cache_shard_t* s, const char* full_path, uint64_t hash, cache_file_t* out)
+{
+    // Ficheiro grande já aberto por um pedido anterior
+    if (cache_fd_lookup(full_path, hash, out)) {
         return 0;
     }
 
-    /* Criar nova entrada de cache com os dados lidos */
-    cache_entry_t* new_e = malloc(sizeof(cache_entry_t));
-    if (!new_e) {
-        pthread_rwlock_unlock(&g_lock);
-        free(buf);
+    cache_flight_t* flight = NULL;
+    switch (flight_begin(s, full_path, hash, &flight)) {
+    case FLIGHT_FAILED:
+        return -1;              // o ficheiro não existe (errno do líder)
+    case FLIGHT_CACHED:
+        if (cache_lookup(s, full_path, hash, out, 0)) {
+            atomic_fetch_add_explicit(&s->coalesced, 1, memory_order_relaxed);
+            return 0;
+        }
+        break;                  // já foi despejado: carregar nós
+    case FLIGHT_LEADER:
+        // O líder anterior pode ter terminado entre a 1ª procura e flight_begin()
+        if (cache_lookup(s, full_path, hash, out, 0)) {
+            flight_end(s, flight, FLIGHT_CACHED, 0);
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
+
+    int rc = load_file(s, full_path, hash, out);
+    if (flight) {
+        int err = errno;
+        int status;
+        if (rc < 0) {
+            // Só "não existe" vale para quem espera; um erro passageiro do líder
+            // (EMFILE, ENOMEM, EIO...) não deve falhar os outros pedidos, que
+            // tentam carregar o ficheiro eles próprios
+            status = (err == ENOENT || err == ENOTDIR) ? FLIGHT_FAILED : FLIGHT_UNCACHED;
+        } else {
+            int cached = out->entry != NULL || out->shm.valid;
+            status = cached ? FLIGHT_CACHED : FLIGHT_UNCACHED;
+        }
+        flight_end(s, flight, status, err);
+        errno = err;
+    }
+    return rc;
+}
+
+
+/**
+ * Lógica:
+ *  0. hash do caminho, calculado uma só vez: escolhe o shard e é usado nas
+ *     procuras O(1) no índice desse shard. Só o lock do shard é usado.
+ *  1. RDLOCK + procura entrada.
+ *     - se encontrar => hit (from_cache=1, is_hit=1); só liga o bit de referência
+ *       (atómico), por isso os hits nunca precisam do WRLOCK e correm em paralelo
+ *  2. se não encontrar => single-flight: se outro thread já está a carregar o
+ *     mesmo ficheiro, espera e usa a entrada que ele inseriu (is_hit=1).
+ *  3. senão (líder) => abrir ficheiro e ver o tamanho.
+ *     - se ficheiro > CACHE_MAX_FILE_SIZE => devolve o fd aberto (para sendfile), sem ler nada
+ *     - se ficheiro <= CACHE_MAX_FILE_SIZE => ler, WRLOCK, volta a verificar, insere se ainda não existir.
+ */
+int cache_get_file(const char* full_path, cache_file_t* out)
+{
+    if (!g_initialized || !full_path || !out) {
         return -1;
     }
 
-    new_e->path = xstrdup(full_path); // copia do caminho (para uso futuro / free)
-    if (!new_e->path) {
-        free(new_e);
-        pthread_rwlock_unlock(&g_lock);
-        free(buf);
+    /* Por omissão, assumimos que não veio do cache e foi um miss */
+    out->data = NULL;
+    out->size = 0;
+    out->fd = -1;
+    out->from_cache = 0;
+    out->is_hit = 0;
+    out->mtime_ns = 0;
+    out->entry = NULL;
+    out->shm.valid = 0;
+    out->open_file = NULL;
+    out->content_type = MIME_DEFAULT;
+    out->validators = NULL;
+    out->header[0] = out->header[1] = NULL;
+    out->header_len[0] = out->header_len[1] = 0;
+    out->gzip.data = NULL;
+
+    char canonical[CANONICAL_PATH_MAX];
+    full_path = canonical_path(full_path, canonical, sizeof(canonical));
+
+    uint64_t hash = hash_path(full_path);
+    cache_shard_t* s = shard_for(hash);
+
+    if (cache_lookup(s, full_path, hash, out, 1)) {
+        return 0;
+    }
+    // 404 recente: responder sem tocar no disco
+    if (negative_lookup(s, full_path, hash)) {
+        out->is_hit = 1;
+        errno = ENOENT;
         return -1;
     }
+    sketch_touch(s, hash);
+    int rc = get_missed_file(s, full_path, hash, out);
+    int err = errno;
+    count_result(s, hash, rc == 0 && out->is_hit);
+    errno = err;
+    return rc;
+}
 
-    /* Transferimos a posse do buffer 'buf' para a nova entrada:
-       não devemos free() esse buffer depois desta atribuição (a nova entrada passa a ser dona). */
-    new_e->data = buf;
-    new_e->size = fsize;
-    new_e->prev = new_e->next = NULL;
 
-    /* Inserir a nova entrada na frente (MRU) e atualizar contadores */
-    lru_insert_front(new_e);
-    g_total_bytes += fsize;
+void cache_release_file(cache_file_t* file) {
+    if (!file) return;
 
-    /* Devolver ao chamador o ponteiro para os dados no cache */
-    *data_out = new_e->data;
-    *size_out = new_e->size;
-    if (from_cache_out) *from_cache_out = 1;
-    // is_hit_out mantém-se 0 porque foi miss inicialmente
+    if (file->open_file) {
+        cache_fd_release(file->open_file);     // o fd continua aberto no cache
+        file->open_file = NULL;
+        file->fd = -1;
+    } else if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    if (file->shm.valid) {
+        cache_shm_release(file);
+    } else if (file->entry) {
+        // Pode libertar a entrada, se foi despejada enquanto a resposta era enviada
+        entry_unref(file->entry);
+        file->entry = NULL;
+    } else if (!file->from_cache && file->data) {
+        // Buffers fora do cache pertencem ao chamador
+        free(file->data);
+    }
+    // Tudo o que apontava para a entrada (ou variante) pode ter sido libertado
+    file->data = NULL;
+    file->content_type = MIME_DEFAULT;
+    file->validators = NULL;
+    for (int ka = 0; ka < 2; ++ka) {
+        file->header[ka] = NULL;
+        file->header_len[ka] = 0;
+        file->gzip.header[ka] = NULL;
+        file->gzip.header_len[ka] = 0;
+    }
+    file->gzip.data = NULL;
+    file->gzip.size = 0;
+    file->gzip.validators = NULL;
+}
+
+
+void cache_invalidate(const char* full_path) {
+    if (!g_initialized) return;
+    atomic_fetch_add(&g_invalidations, 1);
+
+    // "x.css.gz" mudou: a variante de "x.css" pode ter vindo dele
+    size_t len = strlen(full_path);
+    if (g_gzip && len > 3 && len - 3 < CANONICAL_PATH_MAX && strcmp(full_path + len - 3, ".gz") == 0) {
+        char original[CANONICAL_PATH_MAX];
+        memcpy(original, full_path, len - 3);
+        original[len - 3] = '\0';
+        cache_invalidate(original);
+    }
+
+    uint64_t hash = hash_path(full_path);
+    negative_clear(shard_for(hash), full_path, hash);      // o ficheiro pode ter sido criado
+    cache_fd_invalidate(full_path, hash);
+    if (cache_shm_enabled()) {
+        cache_shm_invalidate(full_path, hash);
+        return;
+    }
 
-    pthread_rwlock_unlock(&g_lock);
+    cache_shard_t* s = shard_for(hash);
+    pthread_rwlock_wrlock(&s->lock);
+    cache_entry_t* e = find_entry(s, full_path, hash);
+    if (e) {
+        shard_remove_entry(s, e);
+        atomic_fetch_add_explicit(&s->invalidated, 1, memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(&s->lock);
+    if (e) entry_unref(e);
+}
+
+
+void cache_invalidate_prefix(const char* prefix) {
+    if (!g_initialized) return;
+    atomic_fetch_add(&g_invalidations, 1);
+
+    size_t len = strlen(prefix);
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        cache_shard_t* s = &g_shards[i];
+        pthread_mutex_lock(&s->negative_lock);
+        for (int j = 0; j < NEGATIVE_SLOTS; ++j) {
+            cache_negative_t* n = &s->negative[j];
+            if (n->path && strncmp(n->path, prefix, len) == 0) negative_free(n);
+        }
+        pthread_mutex_unlock(&s->negative_lock);
+    }
+
+    cache_fd_invalidate_prefix(prefix);
+    if (cache_shm_enabled()) {
+        cache_shm_invalidate_prefix(prefix);
+        return;
+    }
+
+    for (unsigned int i = 0; i < g_num_shards; ++i) {
+        cache_shard_t* s = &g_shards[i];
+        pthread_rwlock_wrlock(&s->lock);
+        for (size_t slot = 0; slot < s->index_cap; ++slot) {
+            // O backward-shift pode trazer outra entrada para este slot: voltar a ver
+            cache_entry_t* e;
+            while ((e = s->index[slot]) != NULL && strncmp(e->path, prefix, len) == 0) {
+                shard_remove_entry(s, e);
+                atomic_fetch_add_explicit(&s->invalidated, 1, memory_order_relaxed);
+                // Larga a referência do índice; a entrada é libertada no último cache_release_file()
+                entry_unref(e);
+            }
+        }
+        pthread_rwlock_unlock(&s->lock);
+    }
+}
+
+
+void cache_set_negative_ttl(int ttl_ms) {
+    g_negative_ttl_ns = ttl_ms > 0 ? (uint64_t)ttl_ms * 1000000ULL : 0;
+}
+
+
+int cache_set_gzip(int enabled) {
+    g_gzip = 0;
+    if (!enabled || cache_shm_enabled()) return 0;    // as variantes só existem no cache do processo
+    if (cache_gzip_start() < 0) return -1;
+    g_gzip = 1;
+    return 0;
+}
+
+
+void cache_set_trusted_since(uint64_t since_ns) {
+    atomic_store(&g_trusted_since, since_ns);
+}
+
+
+int cache_num_shards(void) {
+    if (cache_shm_enabled()) return cache_shm_num_shards();
+    return g_initialized ? (int)g_num_shards : 0;
+}
+
+
+int cache_get_shard_stats(int shard, cache_shard_stats_t* out) {
+    if (cache_shm_enabled()) {
+        if (cache_shm_get_shard_stats(shard, out) < 0) return -1;
+        out->rejected = 0;      // o cache partilhado não tem filtro de admissão
+        // O single-flight é por processo: os shards locais têm o mesmo mapeamento
+        out->coalesced = (unsigned int)shard < g_num_shards
+            ? atomic_load_explicit(&g_shards[shard].coalesced, memory_order_relaxed) : 0;
+        out->negative_hits = (unsigned int)shard < g_num_shards
+            ? atomic_load_explicit(&g_shards[shard].negative_hits, memory_order_relaxed) : 0;
+        return 0;
+    }
+    if (!g_initialized || !out || shard < 0 || (unsigned int)shard >= g_num_shards) {
+        return -1;
+    }
+
+    cache_shard_t* s = &g_shards[shard];
+    pthread_rwlock_rdlock(&s->lock);
+    out->entries = s->index_count;
+    out->bytes = s->total_bytes;
+    out->budget = s->max_bytes;
+    pthread_rwlock_unlock(&s->lock);
+
+    out->hits = atomic_load_explicit(&s->hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&s->misses, memory_order_relaxed);
+    out->evictions = atomic_load_explicit(&s->evictions, memory_order_relaxed);
+    out->coalesced = atomic_load_explicit(&s->coalesced, memory_order_relaxed);
+    out->rejected = atomic_load_explicit(&s->rejected, memory_order_relaxed);
+    out->invalidated = atomic_load_explicit(&s->invalidated, memory_order_relaxed);
+    out->negative_hits = atomic_load_explicit(&s->negative_hits, memory_order_relaxed);
     return 0;
 }
+
+
+void cache_print_stats(FILE* fp) {
+    if (!g_initialized || !fp) return;
+
+    if (cache_shm_enabled()) fprintf(fp, "(cache partilhado por todos os worker processes)\n");
+    fprintf(fp, "%-6s %8s %10s %10s %10s %10s %10s %10s %10s %11s %10s\n",
+            "Shard", "Entries", "KB used", "KB budget", "Hits", "Misses", "Evictions", "Rejected",
+            "Coalesced", "Invalidated", "Cached 404");
+    for (int i = 0; i < cache_num_shards(); ++i) {
+        cache_shard_stats_t st;
+        if (cache_get_shard_stats(i, &st) < 0) continue;
+        fprintf(fp, "%-6d %8zu %10zu %10zu %10ld %10ld %10ld %10ld %10ld %11ld %10ld\n", i, st.entries,
+                st.bytes / 1024, st.budget / 1024, st.hits, st.misses, st.evictions, st.rejected,
+                st.coalesced, st.invalidated, st.negative_hits);
+    }
+
+    cache_fd_stats_t fds;
+    if (cache_get_fd_stats(&fds) == 0) {
+        fprintf(fp, "Open file cache: %zu/%zu fds, %ld hits, %ld misses\n",
+                fds.entries, fds.max_entries, fds.hits, fds.misses);
+    }
+    if (g_gzip) {
+        fprintf(fp, "Gzip variants: %ld compressed, %ld from .gz files\n",
+                atomic_load(&g_gzip_compressed), atomic_load(&g_gzip_precompressed));
+    }
+}
@@ -2,6 +2,10 @@
 #define CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "http.h"
 
 /**
  * Limites da Feature 4:
@@ -11,14 +15,31 @@
 #define CACHE_MAX_FILE_SIZE (1024 * 1024)      // 1MB
 #define CACHE_DEFAULT_MAX_BYTES (10 * 1024 * 1024) // 10MB
 
+#define CACHE_DEFAULT_SHARDS 8     // CACHE_SHARDS no server.conf
+#define CACHE_MAX_SHARDS     64
+
 
 /**
  * Inicializa o cache global do processo.
  * max_bytes <= 0 => usa CACHE_DEFAULT_MAX_BYTES.
+ * shards    <= 0 => usa CACHE_DEFAULT_SHARDS (arredondado para potência de 2,
+ *                   no máximo CACHE_MAX_SHARDS).
+ * admission != 0  => filtro de admissão W-TinyLFU: um ficheiro novo só
+ *                   substitui outro se for pedido com mais frequência (resiste
+ *                   a varrimentos de crawlers); 0 => CLOCK simples.
+ * use_mmap != 0   => as entradas são mmap() só de leitura dos ficheiros em vez
+ *                   de cópias no heap (cada byte fica só no page cache; a
+ *                   evicção é um munmap). Os ficheiros devem ser substituídos
+ *                   com rename: truncar um ficheiro mapeado a meio de um envio
+ *                   dá SIGBUS. Ignorado com o cache partilhado.
+ *
+ * O cache é dividido em shards escolhidos pelo hash do caminho, cada um com o
+ * seu lock, índice e orçamento; os orçamentos são redistribuídos conforme a
+ * procura de cada shard (no máximo 1x por segundo), dentro de max_bytes.
  *
  * Retorna 0 em sucesso, -1 em erro.
  */
-int cache_init(long max_bytes);
+int cache_init(long max_bytes, int shards, int admission, int use_mmap);
 
 
 /**
@@ -28,26 +49,241 @@ int cache_init(long max_bytes);
 void cache_destroy(void);
 
 
+struct cache_entry;
+struct cache_fd;
+
+/* Referência a uma entrada do cache partilhado (interno; valid == 0 => nenhuma) */
+typedef struct {
+    int          valid;
+    int          shard;
+    unsigned int slot;
+    unsigned int gen;       // geração do shard quando a referência foi tirada
+} cache_shm_ref_t;
+
 /**
- * Obtém o conteúdo completo de um ficheiro.
+ * Variante de um ficheiro com outra codificação (Content-Encoding), guardada
+ * pelo cache ao lado dos bytes originais. Só é servida pelos headers
+ * pré-formatados (header[1] keep-alive, header[0] close), que já trazem o
+ * Content-Encoding, o Vary e a ETag própria. data == NULL => não há.
+ */
+typedef struct {
+    const char* data;
+    size_t size;
+    const char* header[2];
+    size_t header_len[2];
+    const http_validators_t* validators;
+} cache_variant_t;
+
+/**
+ * Ficheiro devolvido por cache_get_file().
+ *
+ * Ficheiros até CACHE_MAX_FILE_SIZE vêm em memória (data). Ficheiros maiores
+ * nunca são lidos para userspace: ficam abertos em fd e devem ser enviados
+ * com sendfile() (memória constante por download, sem cópias). Com o cache de
+ * ficheiros abertos, o fd pode ser partilhado por vários pedidos: enviar só
+ * com offsets explícitos (sendfile/pread), nunca com lseek/read.
  *
- * full_path       : caminho absoluto (ex: DOCUMENT_ROOT + path do pedido)
- * data_out        : devolve ponteiro para os dados
- * size_out        : devolve tamanho em bytes
- * from_cache_out  : 1 se veio do cache, 0 se foi lido de disco
- * is_hit_out      : 1 se houve *hit* no cache, 0 se foi *miss*
+ * Quando data pertence ao cache, o chamador segura uma referência à entrada:
+ * mesmo que seja despejada entretanto, o buffer só é libertado depois do
+ * último cache_release_file().
  *
- * NOTA:
- *  - Se from_cache_out == 1, NÃO fazemos free(data_out).
- *  - Se from_cache_out == 0, o chamador é responsável por free(data_out).
+ * As entradas do cache do processo guardam também o header da resposta 200
+ * já formatado (header[1] para keep-alive, header[0] para close): um hit é
+ * enviado sem snprintf, e header[1] acaba mesmo antes de data (header e corpo
+ * contíguos, um só buffer) exceto com CACHE_MMAP. NULL => formatar no envio.
+ *
+ * validators (ETag e Last-Modified) também são formatados uma vez por
+ * entrada; quando o ficheiro não ficou em nenhum cache apontam para a cópia
+ * own_validators, dentro do próprio cache_file_t.
+ *
+ * gzip é a variante comprimida de um tipo de texto (ver cache_set_gzip),
+ * válida enquanto a referência à entrada for segurada.
+ */
+typedef struct {
+    char*  data;        // conteúdo em memória (NULL se fd >= 0)
+    size_t size;        // tamanho do ficheiro em bytes
+    int    fd;          // >= 0: ficheiro grande aberto para sendfile(); -1 caso contrário
+    int    from_cache;  // 1 se data pertence ao cache (não fazer free)
+    int    is_hit;      // 1 se houve *hit* no cache, 0 se foi *miss* (em erro: 1 se o 404 veio do cache negativo)
+    int64_t mtime_ns;   // última modificação do ficheiro (ns desde a epoch)
+    const char* content_type;   // tipo MIME, resolvido pela extensão quando o ficheiro entrou no cache
+    const http_validators_t* validators;    // ETag / Last-Modified (NULL em erro)
+    http_validators_t own_validators;       // (interno) validadores de um ficheiro fora do cache
+    struct cache_entry* entry;  // referência segura (interno; NULL se não veio do cache)
+    cache_shm_ref_t shm;        // idem, quando veio do cache partilhado (CACHE_SHARED=1)
+    struct cache_fd* open_file; // fd partilhado do cache de ficheiros abertos (interno; NULL se o fd é só deste pedido)
+    const char* header[2];      // header 200 pré-formatado: [0] Connection: close, [1] keep-alive (ou NULL)
+    size_t header_len[2];
+    cache_variant_t gzip;       // variante gzip (data == NULL se não há)
+} cache_file_t;
+
+
+/**
+ * Obtém um ficheiro, do cache ou do disco.
+ *
+ * full_path : caminho absoluto (ex: DOCUMENT_ROOT + path do pedido)
+ * out       : preenchido com os dados (ou fd) do ficheiro
+ *
+ * Depois de enviar a resposta, o chamador tem de chamar cache_release_file(out).
  *
  * Retorna 0 em sucesso, -1 em erro (ficheiro não existe, erro de I/O, etc).
+ * Um caminho que não existia há pouco falha logo, sem ir ao disco, com
+ * out->is_hit = 1 (ver cache_set_negative_ttl).
+ */
+int cache_get_file(const char* full_path, cache_file_t* out);
+
+
+/**
+ * Liberta o que cache_get_file() entregou ao chamador:
+ * fecha o fd de um ficheiro grande, faz free() de um buffer fora do cache ou
+ * larga a referência à entrada do cache. Chamar só depois de a resposta ter
+ * sido enviada (ou copiada): a partir daqui data pode deixar de ser válido.
+ */
+void cache_release_file(cache_file_t* file);
+
+
+/**
+ * Invalidação quando o conteúdo muda (deploys sem reiniciar o servidor).
+ *
+ * Arranca um thread que segue root (e os subdiretórios) com inotify e tira do
+ * cache só as entradas dos ficheiros alterados, apagados ou substituídos
+ * (rename); o pedido seguinte volta a lê-los do disco. Chamar depois de
+ * cache_init() / cache_shared_join(); o thread termina em cache_destroy().
+ *
+ * Enquanto o inotify não for fiável (não arrancou, faltaram watches, ou a
+ * fila de eventos transbordou), cada entrada é revalidada com stat() (mtime e
+ * tamanho) no máximo uma vez por segundo, quando é pedida.
+ *
+ * Retorna 0 em sucesso, -1 se não foi possível usar o inotify.
+ */
+int cache_watch_start(const char* root);
+
+
+/**
+ * Cache negativo: durante ttl_ms, um caminho que não existia (open() com
+ * ENOENT/ENOTDIR) volta a dar erro sem tocar no disco. Contra tempestades de
+ * 404 (scanners). Limitado a um nº fixo de caminhos por shard (os mais
+ * recentes); o inotify esquece um caminho logo que o ficheiro é criado.
+ * ttl_ms <= 0 desliga. O servidor usa NEGATIVE_CACHE_TTL_MS do server.conf
+ * (1000 ms por omissão, ver config.c).
+ */
+void cache_set_negative_ttl(int ttl_ms);
+
+
+/**
+ * Variantes gzip dos ficheiros de tipos comprimíveis (texto, JSON, SVG...),
+ * para os pedidos com "Accept-Encoding: gzip".
+ *
+ * Cada entrada nova desses tipos é comprimida uma vez por um thread de fundo;
+ * se houver um "ficheiro.gz" ao lado no disco, tão ou mais recente, é usado
+ * esse em vez de comprimir. A variante conta no orçamento do cache e sai com
+ * a entrada. Estas respostas (e as originais) levam "Vary: Accept-Encoding".
+ * Só no cache de cada processo: ignorado com o cache partilhado. Chamar
+ * depois de cache_init() / cache_shared_join().
+ *
+ * Retorna 0 em sucesso, -1 se o thread não arrancou (fica desligado).
+ */
+int cache_set_gzip(int enabled);
+
+
+/**
+ * Cache de ficheiros abertos para os ficheiros grandes (> CACHE_MAX_FILE_SIZE).
+ *
+ * Guarda até max_entries fds abertos (com tamanho, mtime e inode), para que os
+ * downloads repetidos do mesmo ficheiro não paguem open() + fstat() + close().
+ * Passados ttl_ms desde a última confirmação, o pedido seguinte confirma a
+ * entrada com stat() (0 = sempre); com o inotify as alterações tiram-na logo.
+ * max_entries <= 0 deixa-o desligado. Chamar depois de cache_init().
+ *
+ * Retorna 0 em sucesso, -1 em erro.
+ */
+int cache_fd_init(int max_entries, int ttl_ms);
+
+
+/**
+ * Contadores de um shard (para afinar CACHE_SHARDS / CACHE_SIZE_MB).
+ * hits/misses contam cada pedido uma vez, como o worker (is_hit): um pedido
+ * que esperou pelo líder do single-flight é um hit (e conta também em
+ * coalesced); os 404 do cache negativo só contam em negative_hits.
+ */
+typedef struct {
+    size_t entries;     // ficheiros em cache
+    size_t bytes;       // bytes em uso
+    size_t budget;      // orçamento atual do shard
+    long   hits;
+    long   misses;
+    long   evictions;   // inclui os rejeitados
+    long   rejected;    // ficheiros novos que o filtro de admissão não deixou ficar
+    long   coalesced;   // hits que esperaram pela leitura de outro pedido ao mesmo ficheiro
+    long   invalidated; // entradas retiradas porque o ficheiro mudou no disco
+    long   negative_hits;   // 404 respondidos pelo cache negativo (por processo)
+} cache_shard_stats_t;
+
+
+/**
+ * Número de shards em uso (0 se o cache não estiver inicializado).
+ */
+int cache_num_shards(void);
+
+
+/**
+ * Copia os contadores do shard indicado para out. Retorna 0 ou -1.
+ */
+int cache_get_shard_stats(int shard, cache_shard_stats_t* out);
+
+
+/**
+ * Contadores do cache de ficheiros abertos.
+ */
+typedef struct {
+    size_t entries;     // fds abertos guardados
+    size_t max_entries;
+    long   hits;        // pedidos servidos com um fd já aberto
+    long   misses;      // ficheiros grandes abertos do disco
+} cache_fd_stats_t;
+
+
+/**
+ * Copia os contadores do cache de ficheiros abertos. Retorna 0, ou -1 se está desligado.
+ */
+int cache_get_fd_stats(cache_fd_stats_t* out);
+
+
+/**
+ * Escreve uma tabela com os contadores de todos os shards (e os do cache de
+ * ficheiros abertos, se estiver ligado).
+ */
+void cache_print_stats(FILE* fp);
+
+
+#define CACHE_SHM_MAX_WORKERS 32   // referências por entrada são contadas por worker process
+
+/**
+ * Cache partilhado entre worker processes (CACHE_SHARED=1).
+ *
+ * cache_shared_create() é chamado pelo master antes de criar os workers:
+ * cria um segmento de memória partilhada com max_bytes de dados, dividido em
+ * shards (cada shard fica com max_bytes / shards; ficheiros maiores do que
+ * isso não são guardados). Os processos criados a seguir com fork() herdam-no
+ * e o cache_get_file() passa a usá-lo em vez do cache privado do processo.
+ * Retorna 0 em sucesso, -1 em erro (o servidor continua com caches privados).
+ */
+int cache_shared_create(long max_bytes, int shards, int max_workers);
+
+
+/**
+ * Chamado por cada worker process no arranque, depois de cache_init().
+ * Regista o id do worker (para contar as suas referências) e larga as
+ * referências que um processo anterior com o mesmo id deixou ao morrer.
+ * Sem cache partilhado não faz nada.
+ */
+void cache_shared_join(int worker_id);
+
+
+/**
+ * Liberta o segmento partilhado (master, no shutdown, depois dos workers terminarem).
  */
-int cache_get_file(const char* full_path,
-                   char** data_out,
-                   size_t* size_out,
-                   int* from_cache_out,
-                   int* is_hit_out);
+void cache_shared_destroy(void);
 
 
 #endif /* CACHE_H */
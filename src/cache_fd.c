@@ -0,0 +1,320 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "cache_fd.h"
+
+#define FD_CACHE_INACTIVE_NS 60000000000ULL     // entradas sem pedidos há 60s fecham na inserção seguinte
+
+typedef struct cache_fd {
+    char* path;
+    uint64_t hash;
+    int fd;
+    size_t size;
+    int64_t mtime_ns;
+    const char* content_type;   // string estática de mime_name()
+    http_validators_t validators;
+    dev_t dev;                  // dev + inode: o mesmo ficheiro, não só o mesmo nome
+    ino_t ino;
+    _Atomic uint64_t verified_ns;   // último open()/stat() que confirmou a entrada
+    uint64_t used_ns;           // último pedido (com g_lock)
+    atomic_int refs;            // 1 do cache (enquanto está na tabela) + 1 por pedido em curso
+    struct cache_fd* hnext;     // lista do bucket
+    struct cache_fd* prev;      // lista LRU (prev = mais recente)
+    struct cache_fd* next;
+} cache_fd_t;
+
+/*
+ * Uma só tabela por processo, com um mutex: só serve ficheiros > 1MB, em que
+ * o envio custa muito mais do que a procura.
+ */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_fd_t**    g_buckets = NULL;
+static size_t          g_num_buckets = 0;   // potência de 2
+static size_t          g_count = 0;
+static size_t          g_max_entries = 0;   // 0 = desligado
+static uint64_t        g_ttl_ns = 0;
+static cache_fd_t*     g_lru_head = NULL;
+static cache_fd_t*     g_lru_tail = NULL;
+static atomic_long     g_hits;
+static atomic_long     g_misses;
+
+
+static uint64_t coarse_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+static int64_t stat_mtime_ns(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+static void fd_unref(cache_fd_t* e) {
+    if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_acq_rel) == 1) {
+        close(e->fd);
+        free(e->path);
+        free(e);
+    }
+}
+
+
+static void lru_unlink(cache_fd_t* e) {
+    if (e->prev) e->prev->next = e->next;
+    else g_lru_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else g_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+
+static void lru_push_front(cache_fd_t* e) {
+    e->prev = NULL;
+    e->next = g_lru_head;
+    if (g_lru_head) g_lru_head->prev = e;
+    g_lru_head = e;
+    if (!g_lru_tail) g_lru_tail = e;
+}
+
+
+static cache_fd_t* find_locked(const char* path, uint64_t hash) {
+    for (cache_fd_t* e = g_buckets[hash & (g_num_buckets - 1)]; e; e = e->hnext) {
+        if (e->hash == hash && strcmp(e->path, path) == 0) return e;
+    }
+    return NULL;
+}
+
+
+/* Tira e da tabela e da LRU (com g_lock). A referência do cache passa para o chamador. */
+static void remove_locked(cache_fd_t* e) {
+    cache_fd_t** pp = &g_buckets[e->hash & (g_num_buckets - 1)];
+    while (*pp != e) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = e->hnext;
+    lru_unlink(e);
+    g_count--;
+}
+
+
+static void hand_out(cache_fd_t* e, cache_file_t* out) {
+    atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+    out->fd = e->fd;
+    out->size = e->size;
+    out->mtime_ns = e->mtime_ns;
+    out->content_type = e->content_type;
+    out->validators = &e->validators;
+    out->open_file = e;
+}
+
+
+int cache_fd_init(int max_entries, int ttl_ms) {
+    if (max_entries <= 0) return 0;        // desligado
+
+    size_t buckets = 16;
+    while (buckets < 2 * (size_t)max_entries) {
+        buckets <<= 1;
+    }
+    g_buckets = calloc(buckets, sizeof(*g_buckets));
+    if (!g_buckets) {
+        perror("cache_fd_init");
+        return -1;
+    }
+
+    g_num_buckets = buckets;
+    g_max_entries = (size_t)max_entries;
+    g_ttl_ns = ttl_ms > 0 ? (uint64_t)ttl_ms * 1000000ULL : 0;
+    g_count = 0;
+    g_lru_head = g_lru_tail = NULL;
+    atomic_init(&g_hits, 0);
+    atomic_init(&g_misses, 0);
+    return 0;
+}
+
+
+void cache_fd_destroy(void) {
+    if (!g_buckets) return;
+
+    pthread_mutex_lock(&g_lock);
+    while (g_lru_head) {
+        cache_fd_t* e = g_lru_head;
+        remove_locked(e);
+        fd_unref(e);
+    }
+    free(g_buckets);
+    g_buckets = NULL;
+    g_num_buckets = g_max_entries = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+
+int cache_fd_lookup(const char* path, uint64_t hash, cache_file_t* out) {
+    if (!g_buckets) return 0;
+
+    uint64_t now = coarse_now_ns();
+    pthread_mutex_lock(&g_lock);
+    cache_fd_t* e = find_locked(path, hash);
+    if (e) {
+        e->used_ns = now;
+        if (e != g_lru_head) {
+            lru_unlink(e);
+            lru_push_front(e);
+        }
+        hand_out(e, out);
+    }
+    pthread_mutex_unlock(&g_lock);
+    if (!e) return 0;
+
+    /* Passou o TTL: um só pedido confirma com stat() que o caminho ainda é o
+       mesmo ficheiro (inode), com o mesmo tamanho e mtime */
+    uint64_t verified = atomic_load_explicit(&e->verified_ns, memory_order_relaxed);
+    if (now >= verified + g_ttl_ns &&
+        atomic_compare_exchange_strong_explicit(&e->verified_ns, &verified, now,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        struct stat st;
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode) || st.st_ino != e->ino ||
+            st.st_dev != e->dev || (size_t)st.st_size != e->size ||
+            stat_mtime_ns(&st) != e->mtime_ns) {
+            // Só sai se ainda for esta (outro pedido pode já ter posto a nova)
+            pthread_mutex_lock(&g_lock);
+            int found = find_locked(path, hash) == e;
+            if (found) remove_locked(e);
+            pthread_mutex_unlock(&g_lock);
+            if (found) fd_unref(e);
+            fd_unref(e);
+            out->open_file = NULL;
+            out->validators = NULL;
+            out->fd = -1;
+            out->size = 0;
+            out->mtime_ns = 0;
+            return 0;
+        }
+    }
+
+    atomic_fetch_add_explicit(&g_hits, 1, memory_order_relaxed);
+    return 1;
+}
+
+
+void cache_fd_insert(const char* path, uint64_t hash, int fd, const struct stat* st,
+                     const char* content_type, const http_validators_t* validators,
+                     cache_file_t* out) {
+    out->fd = fd;
+    out->content_type = content_type;
+    out->own_validators = *validators;      // até haver entrada (ou se o cache está desligado)
+    out->validators = &out->own_validators;
+    out->size = (size_t)st->st_size;
+    out->mtime_ns = stat_mtime_ns(st);
+    if (!g_buckets) return;
+
+    atomic_fetch_add_explicit(&g_misses, 1, memory_order_relaxed);
+
+    cache_fd_t* e = malloc(sizeof(*e));
+    if (!e) return;
+    e->path = strdup(path);
+    if (!e->path) {
+        free(e);
+        return;
+    }
+    uint64_t now = coarse_now_ns();
+    e->hash = hash;
+    e->fd = fd;
+    e->size = out->size;
+    e->mtime_ns = out->mtime_ns;
+    e->content_type = content_type;
+    e->validators = *validators;
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    atomic_init(&e->verified_ns, now);
+    e->used_ns = now;
+    atomic_init(&e->refs, 2);       // o cache + este pedido
+    out->open_file = e;
+    out->validators = &e->validators;
+
+    cache_fd_t* evicted[2] = { NULL, NULL };
+    int n_evicted = 0;
+
+    pthread_mutex_lock(&g_lock);
+    // Outro pedido pode ter aberto o mesmo ficheiro ao mesmo tempo: fica a mais recente
+    cache_fd_t* old = find_locked(path, hash);
+    if (old) {
+        remove_locked(old);
+        evicted[n_evicted++] = old;
+    }
+    // Cheio, ou a menos usada já não é pedida há muito tempo (fd de um ficheiro apagado?)
+    if (g_lru_tail && (g_count >= g_max_entries || now > g_lru_tail->used_ns + FD_CACHE_INACTIVE_NS)) {
+        cache_fd_t* victim = g_lru_tail;
+        remove_locked(victim);
+        evicted[n_evicted++] = victim;
+    }
+
+    size_t b = hash & (g_num_buckets - 1);
+    e->hnext = g_buckets[b];
+    g_buckets[b] = e;
+    lru_push_front(e);
+    g_count++;
+    pthread_mutex_unlock(&g_lock);
+
+    // close() fora do lock
+    for (int i = 0; i < n_evicted; ++i) {
+        fd_unref(evicted[i]);
+    }
+}
+
+
+void cache_fd_release(cache_fd_t* e) {
+    fd_unref(e);
+}
+
+
+void cache_fd_invalidate(const char* path, uint64_t hash) {
+    if (!g_buckets) return;
+
+    pthread_mutex_lock(&g_lock);
+    cache_fd_t* e = find_locked(path, hash);
+    if (e) remove_locked(e);
+    pthread_mutex_unlock(&g_lock);
+    if (e) fd_unref(e);
+}
+
+
+void cache_fd_invalidate_prefix(const char* prefix) {
+    if (!g_buckets) return;
+
+    size_t len = strlen(prefix);
+    pthread_mutex_lock(&g_lock);
+    cache_fd_t* e = g_lru_head;
+    while (e) {
+        cache_fd_t* next = e->next;
+        if (strncmp(e->path, prefix, len) == 0) {
+            remove_locked(e);
+            fd_unref(e);        // larga a referência da tabela; o fd é fechado quando o último envio o largar
+        }
+        e = next;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+
+int cache_get_fd_stats(cache_fd_stats_t* out) {
+    if (!out || !g_buckets) return -1;
+
+    pthread_mutex_lock(&g_lock);
+    out->entries = g_count;
+    out->max_entries = g_max_entries;
+    pthread_mutex_unlock(&g_lock);
+    out->hits = atomic_load_explicit(&g_hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&g_misses, memory_order_relaxed);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef CACHE_FD_H
+#define CACHE_FD_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+/**
+ * Cache de ficheiros abertos (cache_fd.c), usado por cache.c para os
+ * ficheiros maiores do que CACHE_MAX_FILE_SIZE, que são enviados com
+ * sendfile() a partir de um fd em vez de ficarem em memória.
+ *
+ * Guarda por caminho o fd aberto, o tamanho, o mtime e o inode (como o
+ * open_file_cache do nginx): os pedidos seguintes ao mesmo ficheiro usam o
+ * mesmo fd (o sendfile usa o seu próprio offset) sem open()/fstat()/close().
+ * Cada entrada é confirmada com stat() quando passa o TTL; o inotify tira-a
+ * logo que o ficheiro muda. O arranque (cache_fd_init) está declarado em cache.h.
+ */
+
+
+/**
+ * Procura path. Em hit entrega o fd em out (fd, size, mtime_ns, content_type,
+ * validators, com uma referência em out->open_file) e retorna 1; retorna 0 se
+ * não há entrada válida (o chamador abre o ficheiro e chama cache_fd_insert).
+ */
+int cache_fd_lookup(const char* path, uint64_t hash, cache_file_t* out);
+
+
+/**
+ * Guarda fd (acabado de abrir, com o stat st, o tipo MIME content_type e os
+ * validadores já formatados) e entrega-o em out. O fd passa a pertencer ao cache; se o cache estiver
+ * desligado ou sem memória, out recebe-o como fd próprio (fechado em
+ * cache_release_file).
+ */
+void cache_fd_insert(const char* path, uint64_t hash, int fd, const struct stat* st,
+                     const char* content_type, const http_validators_t* validators,
+                     cache_file_t* out);
+
+
+/**
+ * Larga a referência de um pedido (o fd fecha quando a entrada já saiu do cache).
+ */
+void cache_fd_release(struct cache_fd* e);
+
+
+/**
+ * Retira path (o ficheiro mudou no disco).
+ */
+void cache_fd_invalidate(const char* path, uint64_t hash);
+
+
+/**
+ * Retira todas as entradas cujo caminho começa por prefix.
+ */
+void cache_fd_invalidate_prefix(const char* prefix);
+
+
+/**
+ * Fecha todos os fds guardados (chamado por cache_destroy).
+ */
+void cache_fd_destroy(void);
+
+
+#endif /* CACHE_FD_H */
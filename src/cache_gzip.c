@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "cache_gzip.h"
+
+#define GZIP_QUEUE_SIZE 1024    // entradas à espera (cheia => ficam só com a versão original)
+#define GZIP_LEVEL      9       // cada ficheiro é comprimido uma só vez: vale a compressão máxima
+#define GZIP_WINDOW     (15 + 16)   // 32KB de janela, com header/trailer gzip (não zlib)
+
+static pthread_mutex_t     g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t      g_cond = PTHREAD_COND_INITIALIZER;
+static struct cache_entry* g_queue[GZIP_QUEUE_SIZE];   // fila circular
+static size_t              g_head = 0;
+static size_t              g_count = 0;
+static int                 g_stop = 0;
+static int                 g_running = 0;
+static pthread_t           g_thread;
+
+
+static void* gzip_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (g_count == 0 && !g_stop) {
+            pthread_cond_wait(&g_cond, &g_lock);
+        }
+        if (g_stop) break;
+
+        struct cache_entry* e = g_queue[g_head];
+        g_head = (g_head + 1) % GZIP_QUEUE_SIZE;
+        g_count--;
+
+        // Comprimir sem o lock: os pedidos continuam a pôr entradas na fila
+        pthread_mutex_unlock(&g_lock);
+        cache_gzip_run(e);
+        pthread_mutex_lock(&g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+
+int cache_gzip_start(void) {
+    if (g_running) return 0;
+
+    g_stop = 0;
+    g_head = g_count = 0;
+    if (pthread_create(&g_thread, NULL, gzip_main, NULL) != 0) {
+        perror("pthread_create(gzip)");
+        return -1;
+    }
+    g_running = 1;
+    return 0;
+}
+
+
+void cache_gzip_stop(void) {
+    if (!g_running) return;
+
+    pthread_mutex_lock(&g_lock);
+    g_stop = 1;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+
+    while (g_count > 0) {
+        cache_gzip_drop(g_queue[g_head]);
+        g_head = (g_head + 1) % GZIP_QUEUE_SIZE;
+        g_count--;
+    }
+}
+
+
+int cache_gzip_enqueue(struct cache_entry* e) {
+    int rc = -1;
+    pthread_mutex_lock(&g_lock);
+    if (g_running && !g_stop && g_count < GZIP_QUEUE_SIZE) {
+        g_queue[(g_head + g_count) % GZIP_QUEUE_SIZE] = e;
+        g_count++;
+        pthread_cond_signal(&g_cond);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+
+int cache_gzip_compress(const char* src, size_t size, size_t reserve,
+                        char** block_out, size_t* size_out) {
+    z_stream zs = { 0 };
+    if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+
+    size_t bound = deflateBound(&zs, (uLong)size);
+    char* block = malloc(reserve + bound);
+    if (!block) {
+        deflateEnd(&zs);
+        return -1;
+    }
+
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = (uInt)size;
+    zs.next_out = (Bytef*)(block + reserve);
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t out_size = zs.total_out;
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END || out_size > size - size / 10) {
+        free(block);
+        return -1;
+    }
+    *block_out = block;
+    *size_out = out_size;
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef CACHE_GZIP_H
+#define CACHE_GZIP_H
+
+#include <stddef.h>
+
+/**
+ * Variantes gzip das entradas do cache (cache_gzip.c), usado por cache.c.
+ *
+ * Um thread por processo faz, uma vez e fora do caminho dos pedidos, a
+ * variante das entradas de tipos comprimíveis: lê o ".gz" ao lado no disco
+ * se houver, senão comprime; cache.c junta o resultado à entrada (e conta-o
+ * no orçamento). O
+ * arranque é feito por cache_set_gzip (declarado em cache.h).
+ */
+
+struct cache_entry;
+
+
+/**
+ * Arranca o thread de compressão. Retorna 0, ou -1 em erro.
+ */
+int cache_gzip_start(void);
+
+
+/**
+ * Pára o thread; as entradas ainda na fila são largadas com cache_gzip_drop
+ * (chamado por cache_destroy).
+ */
+void cache_gzip_stop(void);
+
+
+/**
+ * Põe e na fila do compressor. A referência que o chamador tomou passa para a
+ * fila. Retorna -1 se a fila está cheia ou o thread parado (a referência
+ * continua a ser do chamador).
+ */
+int cache_gzip_enqueue(struct cache_entry* e);
+
+
+/**
+ * Comprime src[0..size[ no formato gzip para um bloco novo com reserve bytes
+ * livres à frente (para os headers). Retorna 0 com *block_out (malloc) e o
+ * tamanho comprimido em *size_out, ou -1 em erro ou se não compensa (a
+ * variante não ficaria pelo menos 10% mais pequena).
+ */
+int cache_gzip_compress(const char* src, size_t size, size_t reserve,
+                        char** block_out, size_t* size_out);
+
+
+/* ---------- implementadas em cache.c ---------- */
+
+/**
+ * Faz a variante de e (se ainda estiver em cache) a partir do ".gz" ao lado
+ * ou comprimindo, junta-lha e larga a referência da fila. Chamada pelo thread de compressão.
+ */
+void cache_gzip_run(struct cache_entry* e);
+
+
+/**
+ * Larga a referência de uma entrada que ficou na fila sem ser comprimida.
+ */
+void cache_gzip_drop(struct cache_entry* e);
+
+
+#endif /* CACHE_GZIP_H */
@@ -0,0 +1,707 @@
+#define _XOPEN_SOURCE 700  // expõe shm_open e mutexes robustos (POSIX 2008)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cache_shm.h"
+#include "mime.h"
+
+#define SHM_CACHE_NAME "/webserver_cache"
+
+#define SHM_NIL        ((size_t)-1)     // offset nulo (arena / listas)
+#define NO_ENTRY       UINT32_MAX       // índice de entrada nulo
+#define BLOCK_ALIGN    16
+#define BLOCK_MIN      64               // bloco mais pequeno que vale a pena separar
+#define BLOCK_USED     ((size_t)1)      // bit 0 do tamanho: bloco ocupado
+#define AVG_ENTRY_SIZE 1024             // dimensiona a tabela de entradas (1 por KB de arena)
+#define MIN_ENTRIES    64
+
+enum { ENTRY_FREE = 0, ENTRY_LINKED, ENTRY_DEAD };
+
+/* Cabeçalho de cada bloco da arena. next_free/prev_free só valem em blocos livres. */
+typedef struct {
+    size_t size;        // tamanho do bloco, com o cabeçalho (bit 0 = ocupado)
+    size_t prev_size;   // tamanho do bloco anterior (0 no primeiro), para juntar blocos livres
+    size_t next_free;
+    size_t prev_free;
+} shm_block_t;
+
+/* Entrada: aponta para um bloco da arena com "caminho\0conteúdo" */
+typedef struct {
+    uint64_t hash;
+    size_t   block;                 // offset do bloco na arena
+    size_t   data;                  // offset do conteúdo
+    size_t   size;                  // tamanho do conteúdo
+    int64_t  mtime_ns;              // data de modificação do ficheiro quando foi lido
+    uint64_t verified_ns;           // última vez que se confirmou que o ficheiro não mudou
+    uint32_t prev, next;            // anel CLOCK (next também liga as entradas livres)
+    uint8_t  state;                 // ENTRY_FREE / LINKED / DEAD (despejada, à espera dos pedidos)
+    uint8_t  referenced;            // bit do CLOCK
+    uint16_t mime;                  // tipo MIME (id de mime_lookup, igual em todos os processos)
+    http_validators_t validators;   // ETag e Last-Modified
+    uint16_t refs[CACHE_SHM_MAX_WORKERS];   // pedidos em curso, por worker process
+} shm_entry_t;
+
+/* Todos os offsets são relativos ao início do segmento */
+typedef struct {
+    pthread_mutex_t lock;           // robusto + process-shared
+    unsigned int generation;        // muda quando o shard é reposto (dono do lock morreu)
+    int      quarantined;           // dono do lock morreu: não serve nada até ser reposto
+
+    size_t   index_off;             // uint32_t[index_cap], NO_ENTRY = vazio
+    uint32_t index_cap;
+    uint32_t index_count;
+
+    size_t   entries_off;           // shm_entry_t[entries_cap]
+    uint32_t entries_cap;
+    uint32_t free_entries;          // lista de entradas livres
+    uint32_t hand;                  // ponteiro do CLOCK (NO_ENTRY => vazio)
+
+    size_t   arena_off;
+    size_t   arena_size;
+    size_t   free_list;             // lista de blocos livres (first-fit)
+    size_t   used_bytes;            // bytes ocupados na arena (com cabeçalhos)
+
+    long hits;
+    long misses;
+    long evictions;
+    long invalidated;
+} shm_shard_t;
+
+typedef struct {
+    size_t       total_size;
+    unsigned int num_shards;
+    size_t       shards_off;        // shm_shard_t[num_shards]
+} shm_header_t;
+
+/* Herdados pelos worker processes no fork() */
+static char*         g_base = NULL;
+static shm_header_t* g_hdr = NULL;
+static int           g_worker = 0;   // id deste worker process (índice em refs[])
+
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+#define BLK(off)       ((shm_block_t*)(g_base + (off)))
+
+static shm_shard_t* shard_at(unsigned int i) {
+    return (shm_shard_t*)(g_base + g_hdr->shards_off) + i;
+}
+
+static shm_entry_t* entry_at(shm_shard_t* s, uint32_t i) {
+    return (shm_entry_t*)(g_base + s->entries_off) + i;
+}
+
+static uint32_t* index_slots(shm_shard_t* s) {
+    return (uint32_t*)(g_base + s->index_off);
+}
+
+static const char* entry_path(const shm_entry_t* e) {
+    return g_base + e->block + sizeof(shm_block_t);
+}
+
+
+/* ---------- arena (first-fit, blocos livres vizinhos são juntos) ---------- */
+
+static size_t block_size(const shm_block_t* b) {
+    return b->size & ~BLOCK_USED;
+}
+
+static void free_list_insert(shm_shard_t* s, size_t off) {
+    shm_block_t* b = BLK(off);
+    b->prev_free = SHM_NIL;
+    b->next_free = s->free_list;
+    if (s->free_list != SHM_NIL) BLK(s->free_list)->prev_free = off;
+    s->free_list = off;
+}
+
+static void free_list_remove(shm_shard_t* s, size_t off) {
+    shm_block_t* b = BLK(off);
+    if (b->prev_free != SHM_NIL) {
+        BLK(b->prev_free)->next_free = b->next_free;
+    } else {
+        s->free_list = b->next_free;
+    }
+    if (b->next_free != SHM_NIL) BLK(b->next_free)->prev_free = b->prev_free;
+}
+
+/* Reserva um bloco com payload bytes úteis. Retorna o offset do bloco ou SHM_NIL. */
+static size_t arena_alloc(shm_shard_t* s, size_t payload) {
+    size_t need = ALIGN_UP(payload + sizeof(shm_block_t), BLOCK_ALIGN);
+    if (need < BLOCK_MIN) need = BLOCK_MIN;
+    size_t end = s->arena_off + s->arena_size;
+
+    for (size_t off = s->free_list; off != SHM_NIL; off = BLK(off)->next_free) {
+        shm_block_t* b = BLK(off);
+        size_t size = block_size(b);
+        if (size < need) continue;
+
+        free_list_remove(s, off);
+        if (size - need >= BLOCK_MIN) {
+            // Separar o resto num bloco livre
+            size_t rest = off + need;
+            BLK(rest)->size = size - need;
+            BLK(rest)->prev_size = need;
+            if (rest + (size - need) < end) BLK(rest + (size - need))->prev_size = size - need;
+            free_list_insert(s, rest);
+            size = need;
+        }
+        b->size = size | BLOCK_USED;
+        s->used_bytes += size;
+        return off;
+    }
+    return SHM_NIL;
+}
+
+static void arena_free(shm_shard_t* s, size_t off) {
+    size_t end = s->arena_off + s->arena_size;
+    size_t size = block_size(BLK(off));
+    s->used_bytes -= size;
+
+    size_t next = off + size;
+    if (next < end && !(BLK(next)->size & BLOCK_USED)) {
+        free_list_remove(s, next);
+        size += block_size(BLK(next));
+    }
+    if (off > s->arena_off) {
+        size_t prev = off - BLK(off)->prev_size;
+        if (!(BLK(prev)->size & BLOCK_USED)) {
+            free_list_remove(s, prev);
+            size += block_size(BLK(prev));
+            off = prev;
+        }
+    }
+
+    BLK(off)->size = size;
+    if (off + size < end) BLK(off + size)->prev_size = size;
+    free_list_insert(s, off);
+}
+
+
+/* ---------- índice (linear probing sobre ids de entradas) ---------- */
+
+static uint32_t index_find(shm_shard_t* s, const char* path, uint64_t hash) {
+    uint32_t* slots = index_slots(s);
+    uint32_t mask = s->index_cap - 1;
+    for (uint32_t i = (uint32_t)hash & mask; slots[i] != NO_ENTRY; i = (i + 1) & mask) {
+        shm_entry_t* e = entry_at(s, slots[i]);
+        if (e->hash == hash && strcmp(entry_path(e), path) == 0) {
+            return slots[i];
+        }
+    }
+    return NO_ENTRY;
+}
+
+/* Nunca enche: index_cap >= 2 * entries_cap */
+static void index_insert(shm_shard_t* s, uint32_t id) {
+    uint32_t* slots = index_slots(s);
+    uint32_t mask = s->index_cap - 1;
+    uint32_t i = (uint32_t)entry_at(s, id)->hash & mask;
+    while (slots[i] != NO_ENTRY) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = id;
+    s->index_count++;
+}
+
+/* Remoção com backward-shift (sem tombstones), como no cache privado */
+static void index_remove(shm_shard_t* s, uint32_t id) {
+    uint32_t* slots = index_slots(s);
+    uint32_t mask = s->index_cap - 1;
+    uint32_t i = (uint32_t)entry_at(s, id)->hash & mask;
+    while (slots[i] != id) {
+        if (slots[i] == NO_ENTRY) return;
+        i = (i + 1) & mask;
+    }
+
+    uint32_t hole = i;
+    for (uint32_t j = (i + 1) & mask; slots[j] != NO_ENTRY; j = (j + 1) & mask) {
+        uint32_t home = (uint32_t)entry_at(s, slots[j])->hash & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole] = NO_ENTRY;
+    s->index_count--;
+}
+
+
+/* ---------- entradas e CLOCK ---------- */
+
+static int entry_has_refs(const shm_entry_t* e) {
+    for (int w = 0; w < CACHE_SHM_MAX_WORKERS; ++w) {
+        if (e->refs[w]) return 1;
+    }
+    return 0;
+}
+
+/* Devolve o bloco e a entrada às listas livres */
+static void entry_destroy(shm_shard_t* s, uint32_t id) {
+    shm_entry_t* e = entry_at(s, id);
+    arena_free(s, e->block);
+    e->state = ENTRY_FREE;
+    e->next = s->free_entries;
+    s->free_entries = id;
+}
+
+static void clock_insert(shm_shard_t* s, uint32_t id) {
+    shm_entry_t* e = entry_at(s, id);
+    if (s->hand == NO_ENTRY) {
+        e->prev = e->next = id;
+        s->hand = id;
+        return;
+    }
+    shm_entry_t* h = entry_at(s, s->hand);
+    e->next = s->hand;
+    e->prev = h->prev;
+    entry_at(s, h->prev)->next = id;
+    h->prev = id;
+}
+
+static void clock_remove(shm_shard_t* s, uint32_t id) {
+    shm_entry_t* e = entry_at(s, id);
+    if (e->next == id) {
+        s->hand = NO_ENTRY;
+    } else {
+        entry_at(s, e->prev)->next = e->next;
+        entry_at(s, e->next)->prev = e->prev;
+        if (s->hand == id) s->hand = e->next;
+    }
+}
+
+/* Tira a entrada do índice e do anel; o bloco só é libertado sem pedidos em curso */
+static void entry_unlink(shm_shard_t* s, uint32_t id) {
+    shm_entry_t* e = entry_at(s, id);
+    clock_remove(s, id);
+    index_remove(s, id);
+    if (entry_has_refs(e)) {
+        e->state = ENTRY_DEAD;      // libertada pelo último cache_shm_release()
+    } else {
+        entry_destroy(s, id);
+    }
+}
+
+/* Despeja uma entrada (CLOCK). Retorna 0 se o anel estava vazio. */
+static int clock_evict(shm_shard_t* s) {
+    while (s->hand != NO_ENTRY) {
+        uint32_t id = s->hand;
+        shm_entry_t* e = entry_at(s, id);
+        if (e->referenced) {
+            e->referenced = 0;
+            s->hand = e->next;
+            continue;
+        }
+
+        entry_unlink(s, id);
+        s->evictions++;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* Shard vazio: uma arena com um só bloco livre e todas as entradas livres */
+static void shard_reset(shm_shard_t* s) {
+    s->generation++;
+    s->quarantined = 0;
+
+    uint32_t* slots = index_slots(s);
+    for (uint32_t i = 0; i < s->index_cap; ++i) {
+        slots[i] = NO_ENTRY;
+    }
+    s->index_count = 0;
+
+    for (uint32_t i = 0; i < s->entries_cap; ++i) {
+        shm_entry_t* e = entry_at(s, i);
+        memset(e, 0, sizeof(*e));
+        e->next = (i + 1 < s->entries_cap) ? i + 1 : NO_ENTRY;
+    }
+    s->free_entries = 0;
+    s->hand = NO_ENTRY;
+
+    BLK(s->arena_off)->size = s->arena_size;
+    BLK(s->arena_off)->prev_size = 0;
+    s->free_list = SHM_NIL;
+    free_list_insert(s, s->arena_off);
+    s->used_bytes = 0;
+}
+
+
+/* Repõe um shard em quarentena quando já nenhum pedido envia de um bloco dele */
+static void shard_try_reset(shm_shard_t* s) {
+    if (!s->quarantined) return;
+    for (uint32_t id = 0; id < s->entries_cap; ++id) {
+        if (entry_has_refs(entry_at(s, id))) return;
+    }
+    shard_reset(s);
+}
+
+
+static void shard_lock(shm_shard_t* s) {
+    if (pthread_mutex_lock(&s->lock) == EOWNERDEAD) {
+        // Um worker morreu a meio de uma alteração: o índice, o anel e a arena
+        // podem estar inconsistentes. Os outros workers podem estar a enviar de
+        // blocos da arena, por isso nada é reutilizado: o shard deixa de servir e
+        // de aceitar inserções (quarentena) e só recomeça vazio quando as
+        // referências dos pedidos em curso forem largadas (as do worker morto
+        // são limpas pelo cache_shared_join do seu substituto).
+        uint32_t* slots = index_slots(s);
+        for (uint32_t i = 0; i < s->index_cap; ++i) {
+            slots[i] = NO_ENTRY;
+        }
+        s->index_count = 0;
+        s->hand = NO_ENTRY;
+        s->quarantined = 1;
+        shard_try_reset(s);
+        pthread_mutex_consistent(&s->lock);
+    }
+}
+
+static void shard_unlock(shm_shard_t* s) {
+    pthread_mutex_unlock(&s->lock);
+}
+
+static shm_shard_t* shard_for(uint64_t hash, unsigned int* idx_out) {
+    unsigned int i = (unsigned int)(hash >> 32) & (g_hdr->num_shards - 1);
+    *idx_out = i;
+    return shard_at(i);
+}
+
+/* Entrega a entrada ao chamador com uma referência deste worker. Com o lock. */
+static void hand_out(shm_shard_t* s, unsigned int shard, uint32_t id, cache_file_t* out) {
+    shm_entry_t* e = entry_at(s, id);
+    e->referenced = 1;
+    e->refs[g_worker]++;
+
+    out->data = g_base + e->data;
+    out->size = e->size;
+    out->mtime_ns = e->mtime_ns;
+    out->content_type = mime_name(e->mime);
+    out->validators = &e->validators;
+    out->from_cache = 1;
+    out->shm.valid = 1;
+    out->shm.shard = (int)shard;
+    out->shm.slot = id;
+    out->shm.gen = s->generation;
+}
+
+
+/* ---------- API ---------- */
+
+int cache_shared_create(long max_bytes, int shards, int max_workers) {
+    if (g_base) return 0;
+    if (max_workers > CACHE_SHM_MAX_WORKERS) {
+        fprintf(stderr, "cache partilhado: no máximo %d worker processes\n", CACHE_SHM_MAX_WORKERS);
+        return -1;
+    }
+    if (max_bytes <= 0) max_bytes = CACHE_DEFAULT_MAX_BYTES;
+    if (shards <= 0) shards = CACHE_DEFAULT_SHARDS;
+    if (shards > CACHE_MAX_SHARDS) shards = CACHE_MAX_SHARDS;
+
+    unsigned int num_shards = 1;
+    while (num_shards < (unsigned int)shards) {
+        num_shards <<= 1;
+    }
+
+    // Layout: cabeçalho | shards | por shard: índice, entradas, arena
+    size_t arena_size = ((size_t)max_bytes / num_shards) & ~(size_t)(BLOCK_ALIGN - 1);
+    if (arena_size < BLOCK_MIN) arena_size = BLOCK_MIN;
+    uint32_t entries_cap = (uint32_t)(arena_size / AVG_ENTRY_SIZE);
+    if (entries_cap < MIN_ENTRIES) entries_cap = MIN_ENTRIES;
+    uint32_t index_cap = 1;
+    while (index_cap < 2 * entries_cap) {
+        index_cap <<= 1;
+    }
+
+    size_t shard_bytes = ALIGN_UP(index_cap * sizeof(uint32_t), 64) +
+                         ALIGN_UP(entries_cap * sizeof(shm_entry_t), 64) + arena_size;
+    size_t shards_off = ALIGN_UP(sizeof(shm_header_t), 64);
+    size_t data_off = shards_off + ALIGN_UP(num_shards * sizeof(shm_shard_t), 64);
+    size_t total = data_off + num_shards * shard_bytes;
+
+    shm_unlink(SHM_CACHE_NAME);   // segmento de uma execução anterior que não terminou bem
+    int fd = shm_open(SHM_CACHE_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("shm_open(cache)");
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)total) < 0) {
+        perror("ftruncate(cache)");
+        close(fd);
+        shm_unlink(SHM_CACHE_NAME);
+        return -1;
+    }
+    char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap(cache)");
+        shm_unlink(SHM_CACHE_NAME);
+        return -1;
+    }
+
+    g_base = base;
+    g_hdr = (shm_header_t*)base;
+    g_hdr->total_size = total;
+    g_hdr->num_shards = num_shards;
+    g_hdr->shards_off = shards_off;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+
+    size_t off = data_off;
+    for (unsigned int i = 0; i < num_shards; ++i) {
+        shm_shard_t* s = shard_at(i);
+        memset(s, 0, sizeof(*s));
+        if (pthread_mutex_init(&s->lock, &attr) != 0) {
+            perror("pthread_mutex_init(cache)");
+            pthread_mutexattr_destroy(&attr);
+            cache_shared_destroy();
+            return -1;
+        }
+        s->index_off = off;
+        s->index_cap = index_cap;
+        off += ALIGN_UP(index_cap * sizeof(uint32_t), 64);
+        s->entries_off = off;
+        s->entries_cap = entries_cap;
+        off += ALIGN_UP(entries_cap * sizeof(shm_entry_t), 64);
+        s->arena_off = off;
+        s->arena_size = arena_size;
+        off += arena_size;
+
+        shard_reset(s);
+        s->generation = 0;
+    }
+    pthread_mutexattr_destroy(&attr);
+    return 0;
+}
+
+
+void cache_shared_destroy(void) {
+    if (!g_base) return;
+    munmap(g_base, g_hdr->total_size);
+    shm_unlink(SHM_CACHE_NAME);
+    g_base = NULL;
+    g_hdr = NULL;
+}
+
+
+void cache_shared_join(int worker_id) {
+    if (!g_base || worker_id < 0 || worker_id >= CACHE_SHM_MAX_WORKERS) return;
+    g_worker = worker_id;
+
+    // Um processo anterior com este id pode ter morrido com referências tiradas
+    for (unsigned int i = 0; i < g_hdr->num_shards; ++i) {
+        shm_shard_t* s = shard_at(i);
+        shard_lock(s);
+        for (uint32_t id = 0; id < s->entries_cap; ++id) {
+            shm_entry_t* e = entry_at(s, id);
+            if (e->refs[g_worker] == 0) continue;
+            e->refs[g_worker] = 0;
+            if (!s->quarantined && e->state == ENTRY_DEAD && !entry_has_refs(e)) {
+                entry_destroy(s, id);
+            }
+        }
+        shard_try_reset(s);
+        shard_unlock(s);
+    }
+}
+
+
+int cache_shm_enabled(void) {
+    return g_base != NULL;
+}
+
+
+int cache_shm_lookup(const char* path, uint64_t hash, uint64_t check_before, uint64_t now,
+                     cache_file_t* out, int count) {
+    unsigned int idx;
+    shm_shard_t* s = shard_for(hash, &idx);
+
+    shard_lock(s);
+    uint32_t id = index_find(s, path, hash);
+    if (id == NO_ENTRY) {
+        shard_unlock(s);
+        return 0;
+    }
+    hand_out(s, idx, id, out);
+    if (count) s->hits++;
+
+    // Só um pedido (de qualquer processo) faz a verificação de cada vez
+    shm_entry_t* e = entry_at(s, id);
+    int recheck = e->verified_ns < check_before;
+    if (recheck) e->verified_ns = now;
+    shard_unlock(s);
+    return recheck ? 2 : 1;
+}
+
+
+void cache_shm_count(uint64_t hash, int hit) {
+    unsigned int idx;
+    shm_shard_t* s = shard_for(hash, &idx);
+    shard_lock(s);
+    if (hit) {
+        s->hits++;
+    } else {
+        s->misses++;
+    }
+    shard_unlock(s);
+}
+
+
+int cache_shm_insert(const char* path, uint64_t hash, const char* buf, size_t size,
+                     int64_t mtime_ns, int mime, const http_validators_t* validators,
+                     uint64_t verified_ns, cache_file_t* out) {
+    unsigned int idx;
+    shm_shard_t* s = shard_for(hash, &idx);
+    size_t path_len = strlen(path);
+    size_t payload = path_len + 1 + size;
+    if (ALIGN_UP(payload + sizeof(shm_block_t), BLOCK_ALIGN) > s->arena_size) {
+        return 0;   // nunca cabe neste shard
+    }
+
+    shard_lock(s);
+    if (s->quarantined) {
+        shard_unlock(s);
+        return 0;
+    }
+
+    // Outro thread/processo pode ter inserido o mesmo ficheiro entretanto
+    uint32_t id = index_find(s, path, hash);
+    if (id != NO_ENTRY) {
+        hand_out(s, idx, id, out);
+        out->is_hit = 1;
+        shard_unlock(s);
+        return 1;
+    }
+
+    // Espaço na arena e uma entrada livre, despejando pelo CLOCK se for preciso.
+    // Entradas despejadas ainda em uso só libertam o bloco mais tarde.
+    size_t block;
+    while ((block = arena_alloc(s, payload)) == SHM_NIL) {
+        if (!clock_evict(s)) break;
+    }
+    if (block == SHM_NIL) {
+        shard_unlock(s);
+        return 0;
+    }
+    while (s->free_entries == NO_ENTRY) {
+        if (!clock_evict(s)) break;
+    }
+    if (s->free_entries == NO_ENTRY) {
+        arena_free(s, block);
+        shard_unlock(s);
+        return 0;
+    }
+
+    id = s->free_entries;
+    shm_entry_t* e = entry_at(s, id);
+    s->free_entries = e->next;
+
+    memset(e, 0, sizeof(*e));
+    e->hash = hash;
+    e->block = block;
+    e->data = block + sizeof(shm_block_t) + path_len + 1;
+    e->size = size;
+    e->mtime_ns = mtime_ns;
+    e->verified_ns = verified_ns;
+    e->mime = (mime > 0 && mime <= UINT16_MAX) ? (uint16_t)mime : 0;
+    e->validators = *validators;
+    e->state = ENTRY_LINKED;
+    memcpy(g_base + block + sizeof(shm_block_t), path, path_len + 1);
+    memcpy(g_base + e->data, buf, size);
+
+    index_insert(s, id);
+    clock_insert(s, id);
+    hand_out(s, idx, id, out);
+    e->referenced = 0;   // inserção não conta como uso (como no cache privado)
+
+    shard_unlock(s);
+    return 1;
+}
+
+
+int cache_shm_invalidate(const char* path, uint64_t hash) {
+    if (!g_base) return 0;
+
+    unsigned int idx;
+    shm_shard_t* s = shard_for(hash, &idx);
+    shard_lock(s);
+    uint32_t id = index_find(s, path, hash);
+    if (id != NO_ENTRY) {
+        entry_unlink(s, id);
+        s->invalidated++;
+    }
+    shard_unlock(s);
+    return id != NO_ENTRY;
+}
+
+
+void cache_shm_invalidate_prefix(const char* prefix) {
+    if (!g_base) return;
+
+    size_t len = strlen(prefix);
+    for (unsigned int i = 0; i < g_hdr->num_shards; ++i) {
+        shm_shard_t* s = shard_at(i);
+        shard_lock(s);
+        for (uint32_t id = 0; id < s->entries_cap && !s->quarantined; ++id) {
+            shm_entry_t* e = entry_at(s, id);
+            if (e->state == ENTRY_LINKED && strncmp(entry_path(e), prefix, len) == 0) {
+                entry_unlink(s, id);
+                s->invalidated++;
+            }
+        }
+        shard_unlock(s);
+    }
+}
+
+
+void cache_shm_release(cache_file_t* out) {
+    if (!out->shm.valid || !g_base) return;
+
+    shm_shard_t* s = shard_at((unsigned int)out->shm.shard);
+    shard_lock(s);
+    // Se o shard foi reposto entretanto, a entrada já não é nossa
+    if (out->shm.gen == s->generation) {
+        shm_entry_t* e = entry_at(s, out->shm.slot);
+        if (e->refs[g_worker] > 0) e->refs[g_worker]--;
+        if (s->quarantined) {
+            shard_try_reset(s);     // a arena só é reutilizada quando já ninguém envia dela
+        } else if (e->state == ENTRY_DEAD && !entry_has_refs(e)) {
+            entry_destroy(s, out->shm.slot);
+        }
+    }
+    shard_unlock(s);
+    out->shm.valid = 0;
+}
+
+
+int cache_shm_num_shards(void) {
+    return g_base ? (int)g_hdr->num_shards : 0;
+}
+
+
+int cache_shm_get_shard_stats(int shard, cache_shard_stats_t* out) {
+    if (!g_base || !out || shard < 0 || (unsigned int)shard >= g_hdr->num_shards) {
+        return -1;
+    }
+    shm_shard_t* s = shard_at((unsigned int)shard);
+    shard_lock(s);
+    out->entries = s->index_count;
+    out->bytes = s->used_bytes;
+    out->budget = s->arena_size;
+    out->hits = s->hits;
+    out->misses = s->misses;
+    out->evictions = s->evictions;
+    out->invalidated = s->invalidated;
+    shard_unlock(s);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef CACHE_SHM_H
+#define CACHE_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+/**
+ * Backend do cache em memória partilhada (CACHE_SHARED=1), usado por cache.c.
+ *
+ * O segmento é criado pelo master antes do fork (cache_shared_create) e é
+ * herdado por todos os worker processes, incluindo os que o master volta a
+ * criar depois de um crash: o cache continua quente.
+ *
+ * Está dividido em shards, cada um com um mutex robusto process-shared, um
+ * índice hash (offsets, não ponteiros), uma tabela de entradas com anel CLOCK
+ * e uma arena própria (first-fit com junção de blocos livres vizinhos) onde
+ * ficam o caminho e o conteúdo de cada ficheiro.
+ */
+
+
+/**
+ * 1 se o segmento partilhado existe neste processo.
+ */
+int cache_shm_enabled(void);
+
+
+/**
+ * Procura path no cache partilhado. Em hit preenche out (data aponta para a
+ * arena, com uma referência deste worker) e retorna 1; em miss retorna 0.
+ * Retorna 2 se a entrada foi verificada no disco antes de check_before: passa
+ * a contar como verificada em now e o chamador deve confirmar com stat().
+ * count = 1 conta o hit; count = 0 não mexe nos contadores (procura repetida).
+ * Os pedidos que falham a 1ª procura são contados com cache_shm_count().
+ */
+int cache_shm_lookup(const char* path, uint64_t hash, uint64_t check_before, uint64_t now,
+                     cache_file_t* out, int count);
+
+
+/**
+ * Conta no shard de hash um pedido que falhou a 1ª procura: como hit se
+ * acabou por usar uma entrada que outro pedido inseriu, senão como miss.
+ */
+void cache_shm_count(uint64_t hash, int hit);
+
+
+/**
+ * Copia buf[0..size[ para o cache partilhado (despejando entradas se for
+ * preciso). mtime_ns é a data de modificação lida no open, mime o tipo
+ * (id de mime_lookup), validators a ETag e o Last-Modified já formatados e
+ * verified_ns o instante em que foi lida. Retorna 1 se out passou a apontar para a cópia
+ * partilhada (ou para a que outro processo já tinha inserido, com is_hit=1);
+ * 0 se não coube. buf continua a pertencer ao chamador.
+ */
+int cache_shm_insert(const char* path, uint64_t hash, const char* buf, size_t size,
+                     int64_t mtime_ns, int mime, const http_validators_t* validators,
+                     uint64_t verified_ns, cache_file_t* out);
+
+
+/**
+ * Retira path do cache partilhado (o ficheiro mudou). Retorna 1 se existia.
+ */
+int cache_shm_invalidate(const char* path, uint64_t hash);
+
+
+/**
+ * Retira todas as entradas cujo caminho começa por prefix (diretório apagado
+ * ou movido). Percorre o segmento todo: só para eventos raros.
+ */
+void cache_shm_invalidate_prefix(const char* prefix);
+
+
+/**
+ * Larga a referência de out a uma entrada partilhada.
+ */
+void cache_shm_release(cache_file_t* out);
+
+
+/**
+ * Nº de shards e contadores de cada um (como cache_num_shards/cache_get_shard_stats).
+ */
+int cache_shm_num_shards(void);
+int cache_shm_get_shard_stats(int shard, cache_shard_stats_t* out);
+
+
+#endif /* CACHE_SHM_H */
@@ -0,0 +1,264 @@
+#define _GNU_SOURCE  // inotify, d_type em readdir()
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "cache_watch.h"
+
+/* Tudo o que pode mudar o conteúdo servido num caminho (IN_MODIFY apanha
+   escritas a meio; IN_CLOSE_WRITE volta a invalidar quando terminam) */
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+                    IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW)
+#define WATCH_POLL_MS  250      // o thread repara no stop pelo menos 4x por segundo
+#define WATCH_BUF_SIZE 16384
+
+static int        g_fd = -1;            // inotify
+static pthread_t  g_thread;
+static int        g_running = 0;
+static atomic_int g_stop;
+static int        g_trusted = 0;        // 1 se todos os diretórios ficaram com watch
+
+/* Caminho de cada diretório seguido, indexado pelo watch descriptor (só o thread mexe) */
+static char** g_dirs = NULL;
+static int    g_dirs_cap = 0;
+static int    g_num_watches = 0;
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+static int dirs_set(int wd, const char* path) {
+    if (wd >= g_dirs_cap) {
+        int cap = g_dirs_cap ? g_dirs_cap : 64;
+        while (cap <= wd) {
+            cap *= 2;
+        }
+        char** dirs = realloc(g_dirs, (size_t)cap * sizeof(*dirs));
+        if (!dirs) return -1;
+        memset(dirs + g_dirs_cap, 0, (size_t)(cap - g_dirs_cap) * sizeof(*dirs));
+        g_dirs = dirs;
+        g_dirs_cap = cap;
+    }
+
+    char* copy = strdup(path);
+    if (!copy) return -1;
+    if (g_dirs[wd]) {
+        free(g_dirs[wd]);       // o mesmo diretório visto outra vez (wd repetido)
+    } else {
+        g_num_watches++;
+    }
+    g_dirs[wd] = copy;
+    return 0;
+}
+
+
+static void dirs_clear(int wd) {
+    if (wd < 0 || wd >= g_dirs_cap || !g_dirs[wd]) return;
+    free(g_dirs[wd]);
+    g_dirs[wd] = NULL;
+    g_num_watches--;
+}
+
+
+/* Junta dir e name como os pedidos: "www" + "a.css" -> "www/a.css" */
+static int join_path(char* out, size_t size, const char* dir, const char* name) {
+    size_t len = strlen(dir);
+    int n = (len > 0 && dir[len - 1] == '/') ? snprintf(out, size, "%s%s", dir, name)
+                                             : snprintf(out, size, "%s/%s", dir, name);
+    return (n < 0 || (size_t)n >= size) ? -1 : 0;
+}
+
+
+/* Segue dir e todos os subdiretórios. Retorna 0, ou -1 se algum ficou sem watch. */
+static int watch_tree(const char* dir) {
+    int wd = inotify_add_watch(g_fd, dir, WATCH_MASK);
+    if (wd < 0 || dirs_set(wd, dir) < 0) {
+        return -1;
+    }
+
+    DIR* d = opendir(dir);
+    if (!d) return -1;
+
+    int rc = 0;
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+
+        char path[PATH_MAX];
+        if (join_path(path, sizeof(path), dir, de->d_name) < 0) {
+            rc = -1;
+            continue;
+        }
+
+        int is_dir = (de->d_type == DT_DIR);
+        if (de->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = lstat(path, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir && watch_tree(path) < 0) rc = -1;
+    }
+    closedir(d);
+    return rc;
+}
+
+
+/* Um diretório saiu da árvore: deixar de o seguir, e aos subdiretórios */
+static void unwatch_tree(const char* dir) {
+    size_t len = strlen(dir);
+    for (int wd = 0; wd < g_dirs_cap; ++wd) {
+        const char* p = g_dirs[wd];
+        if (p && strncmp(p, dir, len) == 0 && (p[len] == '\0' || p[len] == '/')) {
+            inotify_rm_watch(g_fd, wd);
+            dirs_clear(wd);
+        }
+    }
+}
+
+
+static void lose_trust(const char* why) {
+    g_trusted = 0;
+    cache_set_trusted_since(UINT64_MAX);
+    fprintf(stderr, "cache: %s, a revalidar ficheiros pelo mtime\n", why);
+}
+
+
+static void handle_event(const struct inotify_event* ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        // Perderam-se eventos: o que foi verificado até agora volta a ser confirmado com stat()
+        if (g_trusted) cache_set_trusted_since(now_ns());
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        dirs_clear(ev->wd);     // diretório apagado (ou watch removido)
+        return;
+    }
+    if (ev->len == 0 || ev->wd < 0 || ev->wd >= g_dirs_cap || !g_dirs[ev->wd]) return;
+
+    char path[PATH_MAX];
+    if (join_path(path, sizeof(path), g_dirs[ev->wd], ev->name) < 0) return;
+
+    if (ev->mask & IN_ISDIR) {
+        char prefix[PATH_MAX + 1];
+        snprintf(prefix, sizeof(prefix), "%s/", path);
+
+        if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            unwatch_tree(path);
+            cache_invalidate_prefix(prefix);
+        } else if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            // Pode substituir um diretório com o mesmo nome
+            cache_invalidate_prefix(prefix);
+            if (watch_tree(path) < 0 && g_trusted) lose_trust("sem watches para todos os diretórios");
+        }
+        return;
+    }
+
+    cache_invalidate(path);
+}
+
+
+static void* watch_main(void* arg) {
+    (void)arg;
+    char buf[WATCH_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!atomic_load(&g_stop)) {
+        struct pollfd pfd = { .fd = g_fd, .events = POLLIN };
+        if (poll(&pfd, 1, WATCH_POLL_MS) <= 0) {
+            continue;       // timeout ou EINTR
+        }
+
+        ssize_t n = read(g_fd, buf, sizeof(buf));
+        if (n <= 0) continue;
+
+        for (char* p = buf; p < buf + n; ) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            handle_event(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return NULL;
+}
+
+
+static void watch_cleanup(void) {
+    if (g_fd >= 0) close(g_fd);
+    g_fd = -1;
+    for (int wd = 0; wd < g_dirs_cap; ++wd) {
+        free(g_dirs[wd]);
+    }
+    free(g_dirs);
+    g_dirs = NULL;
+    g_dirs_cap = g_num_watches = 0;
+    g_trusted = 0;
+}
+
+
+int cache_watch_start(const char* root) {
+    if (g_running || !root || root[0] == '\0') return -1;
+
+    // Os pedidos usam raiz + "/" + caminho: tirar as barras do fim da raiz
+    char dir[PATH_MAX];
+    if (strlen(root) >= sizeof(dir)) return -1;
+    strcpy(dir, root);
+    for (size_t len = strlen(dir); len > 1 && dir[len - 1] == '/'; --len) {
+        dir[len - 1] = '\0';
+    }
+
+    g_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_fd < 0) {
+        perror("inotify_init1");
+        return -1;
+    }
+
+    // Tudo o que for lido a partir daqui é seguido pelos watches
+    uint64_t since = now_ns();
+    int rc = watch_tree(dir);
+    if (g_num_watches == 0) {
+        perror("inotify_add_watch");
+        watch_cleanup();
+        return -1;
+    }
+    if (rc == 0) {
+        g_trusted = 1;
+        cache_set_trusted_since(since);
+    } else {
+        lose_trust("sem watches para todos os diretórios (fs.inotify.max_user_watches?)");
+    }
+
+    atomic_store(&g_stop, 0);
+    if (pthread_create(&g_thread, NULL, watch_main, NULL) != 0) {
+        perror("pthread_create(inotify)");
+        cache_set_trusted_since(UINT64_MAX);
+        watch_cleanup();
+        return -1;
+    }
+    g_running = 1;
+    return 0;
+}
+
+
+void cache_watch_stop(void) {
+    if (!g_running) return;
+
+    atomic_store(&g_stop, 1);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+
+    cache_set_trusted_since(UINT64_MAX);
+    watch_cleanup();
+}
@@ -0,0 +1,45 @@
+#ifndef CACHE_WATCH_H
+#define CACHE_WATCH_H
+
+#include <stdint.h>
+
+/**
+ * Invalidação do cache por inotify (cache_watch.c), usada por cache.c.
+ *
+ * Um thread por processo segue DOCUMENT_ROOT e todos os subdiretórios e,
+ * por cada ficheiro alterado, apagado ou substituído, chama
+ * cache_invalidate() com o mesmo caminho que os pedidos usam como chave
+ * (raiz + "/" + caminho relativo). O arranque (cache_watch_start) está
+ * declarado em cache.h.
+ */
+
+
+/**
+ * Pára o thread do inotify e liberta os watches (chamado por cache_destroy).
+ */
+void cache_watch_stop(void);
+
+
+/* ---------- implementadas em cache.c ---------- */
+
+/**
+ * Retira do cache a entrada de full_path, se existir.
+ */
+void cache_invalidate(const char* full_path);
+
+
+/**
+ * Retira todas as entradas cujo caminho começa por prefix (diretório apagado ou movido).
+ */
+void cache_invalidate_prefix(const char* prefix);
+
+
+/**
+ * A partir de since_ns (CLOCK_MONOTONIC) o inotify vê todas as alterações:
+ * entradas verificadas depois disso deixam de precisar de stat().
+ * UINT64_MAX volta à revalidação por mtime.
+ */
+void cache_set_trusted_since(uint64_t since_ns);
+
+
+#endif /* CACHE_WATCH_H */
@@ -0,0 +1,48 @@
+#include "codel.h"
+
+
+void codel_init(codel_t* c, int target_ms, int interval_ms) {
+    c->target_ns = (target_ms > 0) ? (uint64_t)target_ms * 1000000ull : 0;
+    c->interval_ns = (uint64_t)(interval_ms > 0 ? interval_ms : 100) * 1000000ull;
+    atomic_init(&c->interval_end_ns, 0);
+    atomic_init(&c->min_delay_ns, 0);
+    atomic_init(&c->reset_pending, 0);
+    atomic_init(&c->overloaded, 0);
+}
+
+
+int codel_should_drop(codel_t* c, uint64_t enqueued_ns, uint64_t now_ns) {
+    if (c->target_ns == 0) {
+        return 0;
+    }
+
+    uint64_t delay = (now_ns > enqueued_ns) ? now_ns - enqueued_ns : 0;
+
+    // Fim do intervalo: decidir o estado a partir do mínimo do intervalo
+    // que acabou. Só uma thread faz a transição (exchange em reset_pending).
+    uint64_t min_delay = atomic_load_explicit(&c->min_delay_ns, memory_order_relaxed);
+    if (now_ns > atomic_load_explicit(&c->interval_end_ns, memory_order_relaxed) &&
+        !atomic_load_explicit(&c->reset_pending, memory_order_acquire) &&
+        !atomic_exchange_explicit(&c->reset_pending, 1, memory_order_acq_rel)) {
+        atomic_store_explicit(&c->interval_end_ns, now_ns + c->interval_ns, memory_order_relaxed);
+        atomic_store_explicit(&c->overloaded, min_delay > c->target_ns, memory_order_relaxed);
+    }
+
+    // O primeiro pedido do novo intervalo define o mínimo inicial e nunca é
+    // rejeitado: é preciso mais do que um pedido num intervalo para cortar.
+    if (atomic_load_explicit(&c->reset_pending, memory_order_acquire) &&
+        atomic_exchange_explicit(&c->reset_pending, 0, memory_order_acq_rel)) {
+        atomic_store_explicit(&c->min_delay_ns, delay, memory_order_relaxed);
+        return 0;
+    }
+
+    // Mínimo atómico (perder uma atualização numa corrida não tem impacto)
+    while (delay < min_delay &&
+           !atomic_compare_exchange_weak_explicit(&c->min_delay_ns, &min_delay, delay,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+
+    return atomic_load_explicit(&c->overloaded, memory_order_relaxed) &&
+           delay > 2 * c->target_ns;
+}
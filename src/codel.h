@@ -0,0 +1,56 @@
+#ifndef CODEL_H
+#define CODEL_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * Controlador de carga CoDel (Controlled Delay) para a fila de ligações.
+ *
+ * Em vez de rejeitar só quando a fila enche, mede o tempo que cada ligação
+ * esperou na fila (sojourn time) e usa o MÍNIMO desse tempo em cada intervalo
+ * como indicador de fila "parada" (standing queue):
+ *
+ *  - se durante um intervalo inteiro nenhuma ligação esperou menos do que
+ *    target, a fila não está a escoar e o worker process fica "sobrecarregado";
+ *  - enquanto sobrecarregado, as ligações que esperaram mais de 2 * target
+ *    são rejeitadas com 503 logo que saem da fila (load shedding).
+ *
+ * Um pico curto não chega para marcar sobrecarga (basta um pedido rápido no
+ * intervalo para o mínimo descer abaixo de target), por isso rajadas são
+ * absorvidas pela fila sem 503.
+ *
+ * Partilhado por todas as worker threads de um worker process; só usa atómicos.
+ */
+
+typedef struct {
+    uint64_t target_ns;                 // atraso aceitável na fila (0 = desligado)
+    uint64_t interval_ns;               // janela de observação do atraso mínimo
+    _Atomic uint64_t interval_end_ns;   // fim do intervalo atual
+    _Atomic uint64_t min_delay_ns;      // menor atraso visto no intervalo atual
+    atomic_int reset_pending;           // 1 enquanto uma thread inicia o novo intervalo
+    atomic_int overloaded;              // 1 se o intervalo anterior não escoou a fila
+} codel_t;
+
+
+/**
+ * Inicializa o controlador.
+ * target_ms   : atraso alvo na fila (CODEL_TARGET_MS); <= 0 desliga o CoDel
+ * interval_ms : duração do intervalo (CODEL_INTERVAL_MS)
+ */
+void codel_init(codel_t* c, int target_ms, int interval_ms);
+
+
+/**
+ * Regista o atraso de uma ligação acabada de retirar da fila e decide se
+ * deve ser rejeitada.
+ *
+ * enqueued_ns : instante do enqueue (conn_queue_pop)
+ * now_ns      : instante atual (conn_queue_now_ns)
+ *
+ * Retorna 1 se a ligação deve ser rejeitada com 503, 0 caso contrário.
+ */
+int codel_should_drop(codel_t* c, uint64_t enqueued_ns, uint64_t now_ns);
+
+
+#endif /* CODEL_H */
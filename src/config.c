@@ -8,11 +8,23 @@ int load_config(const char* filename, server_config_t* config) {
     config->port = 8080;
     config->num_workers = 1;
     config->threads_per_worker = 1;
-    config->max_queue_size = 100;
+    config->max_queue_size = 1024;
     config->cache_size_mb = 10;
+    config->cache_shards = 8;
+    config->cache_shared = 0;
+    config->cache_admission = 1;
+    config->cache_mmap = 0;
+    config->cache_gzip = 1;
+    config->fd_cache_entries = 64;
+    config->fd_cache_ttl_ms = 1000;
+    config->negative_cache_ttl_ms = 1000;
     config->timeout_seconds = 30;
+    config->codel_target_ms = 5;
+    config->codel_interval_ms = 100;
+    config->tcp_cork = 0;
     strcpy(config->document_root, "www");
     strcpy(config->log_file, "access.log");
+    config->mime_types_file[0] = '\0';
 
     FILE* fp = fopen(filename, "r");
     if (!fp) return -1;
@@ -45,8 +57,45 @@ int load_config(const char* filename, server_config_t* config) {
             } else if (strcmp(key, "CACHE_SIZE_MB") == 0) {
                 config->cache_size_mb = atoi(value);
 
+            } else if (strcmp(key, "CACHE_SHARDS") == 0) {
+                config->cache_shards = atoi(value);
+
+            } else if (strcmp(key, "CACHE_SHARED") == 0) {
+                config->cache_shared = atoi(value);
+
+            } else if (strcmp(key, "CACHE_ADMISSION") == 0) {
+                config->cache_admission = atoi(value);
+
+            } else if (strcmp(key, "CACHE_MMAP") == 0) {
+                config->cache_mmap = atoi(value);
+
+            } else if (strcmp(key, "CACHE_GZIP") == 0) {
+                config->cache_gzip = atoi(value);
+
+            } else if (strcmp(key, "FD_CACHE_ENTRIES") == 0) {
+                config->fd_cache_entries = atoi(value);
+
+            } else if (strcmp(key, "FD_CACHE_TTL_MS") == 0) {
+                config->fd_cache_ttl_ms = atoi(value);
+
+            } else if (strcmp(key, "NEGATIVE_CACHE_TTL_MS") == 0) {
+                config->negative_cache_ttl_ms = atoi(value);
+
+            } else if (strcmp(key, "MIME_TYPES_FILE") == 0) {
+                strncpy(config->mime_types_file, value, sizeof(config->mime_types_file) - 1);
+                config->mime_types_file[sizeof(config->mime_types_file) - 1] = '\0';
+
             } else if (strcmp(key, "TIMEOUT_SECONDS") == 0) {
                 config->timeout_seconds = atoi(value);
+
+            } else if (strcmp(key, "CODEL_TARGET_MS") == 0) {
+                config->codel_target_ms = atoi(value);
+
+            } else if (strcmp(key, "CODEL_INTERVAL_MS") == 0) {
+                config->codel_interval_ms = atoi(value);
+
+            } else if (strcmp(key, "TCP_CORK") == 0) {
+                config->tcp_cork = atoi(value);
             }
         }
     }
@@ -9,7 +9,19 @@ typedef struct {
     int max_queue_size;
     char log_file[256];
     int cache_size_mb;
+    int cache_shards;         // nº de shards do cache de ficheiros (potência de 2)
+    int cache_shared;         // 1 = um só cache em memória partilhada para todos os worker processes
+    int cache_admission;      // 1 = filtro de admissão W-TinyLFU no cache de cada processo
+    int cache_mmap;           // 1 = entradas do cache são mmap() dos ficheiros (sem cópia no heap)
+    int cache_gzip;           // 1 = variantes gzip dos tipos de texto no cache (Accept-Encoding)
+    int fd_cache_entries;     // fds de ficheiros grandes mantidos abertos por processo (0 = desligado)
+    int fd_cache_ttl_ms;      // validade de um fd em cache antes de o confirmar com stat()
+    int negative_cache_ttl_ms;    // durante quanto tempo um 404 é respondido sem ir ao disco (0 = desligado)
+    char mime_types_file[256];    // tipos MIME extra no formato mime.types ("" = só os embutidos)
     int timeout_seconds;
+    int codel_target_ms;      // atraso alvo na fila antes de rejeitar (0 = desligado)
+    int codel_interval_ms;    // intervalo de observação do CoDel
+    int tcp_cork;             // 1 = TCP_CORK entre header e corpo nas respostas com sendfile
 } server_config_t;
 
 int load_config(const char* filename, server_config_t* config);
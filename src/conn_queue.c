@@ -0,0 +1,220 @@
+#define _GNU_SOURCE  // expõe syscall()
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "conn_queue.h"
+
+#define POP_SPIN_ITERATIONS 64   // tentativas antes de dormir no futex
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() atomic_signal_fence(memory_order_seq_cst)
+#endif
+
+
+static void futex_wait(atomic_uint* addr, unsigned int expected) {
+    // Só dorme se *addr ainda valer expected (o kernel verifica atomicamente)
+    syscall(SYS_futex, (unsigned int*)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* addr, int count) {
+    syscall(SYS_futex, (unsigned int*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+
+uint64_t conn_queue_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+int conn_queue_init(connection_queue_t* q, int capacity) {
+    if (!q) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Arredondar para potência de 2 (índice com máscara em vez de módulo)
+    size_t cap = 1;
+    size_t wanted = (capacity > 0) ? (size_t)capacity : 1;
+    if (wanted > QUEUE_MAX_CAPACITY) wanted = QUEUE_MAX_CAPACITY;
+    while (cap < wanted) cap <<= 1;
+
+    q->slots = malloc(cap * sizeof(conn_slot_t));
+    if (!q->slots) {
+        return -1;
+    }
+    q->capacity = cap;
+    q->mask = cap - 1;
+
+    // Slot i começa "livre para a posição i"
+    for (size_t i = 0; i < q->capacity; ++i) {
+        atomic_init(&q->slots[i].seq, i);
+        q->slots[i].fd = -1;
+        q->slots[i].enqueued_ns = 0;
+    }
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->wake_seq, 0);
+    atomic_init(&q->sleepers, 0);
+    atomic_init(&q->closed, 0);
+    atomic_init(&q->high_water, 0);
+
+    // Com um só CPU, esperar ativamente só rouba tempo ao produtor
+    q->spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? POP_SPIN_ITERATIONS : 0;
+    return 0;
+}
+
+
+void conn_queue_destroy(connection_queue_t* q) {
+    if (!q) return;
+    free(q->slots);
+    q->slots = NULL;
+    q->capacity = 0;
+    q->mask = 0;
+}
+
+
+/* Atualiza o high-water mark (máximo atómico; só escreve quando há um novo máximo). */
+static void note_depth(connection_queue_t* q, size_t depth) {
+    size_t hw = atomic_load_explicit(&q->high_water, memory_order_relaxed);
+    while (depth > hw &&
+           !atomic_compare_exchange_weak_explicit(&q->high_water, &hw, depth,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+
+/*
+ * Produtor: reserva a posição head com CAS; o slot está livre quando
+ * seq == pos. Depois de escrever, publica com seq = pos + 1.
+ */
+int conn_queue_try_push(connection_queue_t* q, int fd) {
+    uint64_t now = conn_queue_now_ns();   // fora do loop de CAS (vDSO, sem syscall)
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    while (1) {
+        conn_slot_t* slot = &q->slots[pos & q->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                slot->fd = fd;
+                slot->enqueued_ns = now;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+                long depth = (long)(pos + 1 - atomic_load_explicit(&q->tail, memory_order_relaxed));
+                if (depth > 0) note_depth(q, (size_t)depth);
+                break;
+            }
+            // CAS falhou: pos foi atualizado com o valor atual de head
+        } else if (diff < 0) {
+            return -1;  // fila cheia (o slot ainda não foi consumido)
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    // Par de barreiras com conn_queue_pop(): ou vemos o consumidor em sleepers,
+    // ou ele vê o nosso item antes de adormecer (sem wakeups perdidos).
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->sleepers, memory_order_relaxed) > 0) {
+        atomic_fetch_add_explicit(&q->wake_seq, 1, memory_order_release);
+        futex_wake(&q->wake_seq, 1);
+    }
+    return 0;
+}
+
+
+/*
+ * Consumidor: o slot em tail tem item quando seq == pos + 1. Depois de ler,
+ * liberta-o para a volta seguinte do anel com seq = pos + capacity.
+ */
+int conn_queue_try_pop(connection_queue_t* q, int* fd_out, uint64_t* enqueued_ns) {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    while (1) {
+        conn_slot_t* slot = &q->slots[pos & q->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long)(seq - (pos + 1));
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *fd_out = slot->fd;
+                if (enqueued_ns) *enqueued_ns = slot->enqueued_ns;
+                atomic_store_explicit(&slot->seq, pos + q->capacity, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;  // fila vazia
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+}
+
+
+int conn_queue_pop(connection_queue_t* q, uint64_t* enqueued_ns) {
+    int fd;
+
+    if (conn_queue_try_pop(q, &fd, enqueued_ns) == 0) {
+        return fd;
+    }
+
+    while (1) {
+        // Espera ativa curta: em multi-core o próximo item chega muitas vezes
+        // antes de compensar o custo de dormir e acordar no futex
+        for (int i = 0; i < q->spin; ++i) {
+            if (conn_queue_try_pop(q, &fd, enqueued_ns) == 0) {
+                return fd;
+            }
+            cpu_relax();
+        }
+
+        if (atomic_load_explicit(&q->closed, memory_order_acquire)) {
+            return -1;
+        }
+
+        // Anunciar que vamos dormir e voltar a verificar antes do futex_wait
+        unsigned int seq = atomic_load_explicit(&q->wake_seq, memory_order_acquire);
+        atomic_fetch_add_explicit(&q->sleepers, 1, memory_order_seq_cst);
+
+        if (conn_queue_try_pop(q, &fd, enqueued_ns) == 0) {
+            atomic_fetch_sub_explicit(&q->sleepers, 1, memory_order_relaxed);
+            return fd;
+        }
+        if (atomic_load_explicit(&q->closed, memory_order_acquire)) {
+            atomic_fetch_sub_explicit(&q->sleepers, 1, memory_order_relaxed);
+            return -1;
+        }
+
+        futex_wait(&q->wake_seq, seq);
+        atomic_fetch_sub_explicit(&q->sleepers, 1, memory_order_relaxed);
+    }
+}
+
+
+void conn_queue_close(connection_queue_t* q) {
+    atomic_store_explicit(&q->closed, 1, memory_order_release);
+    atomic_fetch_add_explicit(&q->wake_seq, 1, memory_order_release);
+    futex_wake(&q->wake_seq, INT_MAX);
+}
+
+
+size_t conn_queue_high_water(connection_queue_t* q) {
+    return atomic_load_explicit(&q->high_water, memory_order_relaxed);
+}
@@ -0,0 +1,111 @@
+#ifndef CONN_QUEUE_H
+#define CONN_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define QUEUE_MAX_CAPACITY  (1 << 20)   // limite de sanidade para MAX_QUEUE_SIZE
+#define CACHE_LINE_SIZE     64
+
+/**
+ * Fila bounded de ligações (client_fd) de um worker process.
+ *
+ * Cada worker process tem a sua própria fila: os fds só são válidos dentro
+ * do processo que fez accept(), por isso a fila não vive em memória partilhada.
+ * Produtor: event loop do processo. Consumidores: worker threads do processo.
+ *
+ * Implementação lock-free multi-producer/multi-consumer (ring buffer com
+ * números de sequência por slot): enqueue e dequeue não fazem syscalls no caso
+ * normal. Só há um futex wake quando existem consumidores a dormir.
+ *
+ * A capacidade é alocada no arranque a partir de MAX_QUEUE_SIZE (server.conf),
+ * arredondada para a potência de 2 seguinte: o índice do slot é pos & mask.
+ *
+ * Cada slot guarda também o instante em que o fd entrou na fila (relógio
+ * monotónico), para o controlador CoDel medir o tempo de espera (sojourn time).
+ */
+
+typedef struct {
+    atomic_size_t seq;      // sequência do slot (indica se está livre ou ocupado)
+    int fd;                 // socket do cliente
+    uint64_t enqueued_ns;   // instante do enqueue (CLOCK_MONOTONIC, ns)
+} conn_slot_t;
+
+typedef struct {
+    /* head/tail em cache lines separadas para produtores e consumidores
+       não invalidarem as linhas uns dos outros (false sharing) */
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;   // próxima posição a escrever
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;   // próxima posição a ler
+
+    _Alignas(CACHE_LINE_SIZE) atomic_uint wake_seq; // palavra do futex (muda a cada wake)
+    atomic_int sleepers;                            // consumidores bloqueados no futex
+    atomic_int closed;                              // 1 após conn_queue_close()
+    int spin;                                       // tentativas antes de dormir (0 em single-core)
+    atomic_size_t high_water;                       // maior profundidade observada
+
+    _Alignas(CACHE_LINE_SIZE) size_t capacity;      // potência de 2
+    size_t mask;                                    // capacity - 1
+    conn_slot_t* slots;                             // capacity slots
+} connection_queue_t;
+
+
+/**
+ * Inicializa a fila com pelo menos 'capacity' slots (arredondado para a
+ * potência de 2 seguinte, até QUEUE_MAX_CAPACITY).
+ * Retorna 0 em sucesso, -1 em erro (sem memória).
+ */
+int conn_queue_init(connection_queue_t* q, int capacity);
+
+
+/**
+ * Liberta os slots da fila. Chamar apenas quando já não há produtores nem consumidores.
+ */
+void conn_queue_destroy(connection_queue_t* q);
+
+
+/**
+ * Tenta inserir um fd sem bloquear.
+ * Acorda um consumidor apenas se houver algum a dormir.
+ * Retorna 0 em sucesso, -1 se a fila estiver cheia.
+ */
+int conn_queue_try_push(connection_queue_t* q, int fd);
+
+
+/**
+ * Tenta retirar um fd sem bloquear.
+ * Se enqueued_ns != NULL, devolve aí o instante em que o fd entrou na fila.
+ * Retorna 0 em sucesso (fd em *fd_out), -1 se a fila estiver vazia.
+ */
+int conn_queue_try_pop(connection_queue_t* q, int* fd_out, uint64_t* enqueued_ns);
+
+
+/**
+ * Retira um fd, bloqueando (futex) enquanto a fila estiver vazia.
+ * Se enqueued_ns != NULL, devolve aí o instante em que o fd entrou na fila.
+ * Retorna o fd, ou -1 se a fila foi fechada com conn_queue_close().
+ */
+int conn_queue_pop(connection_queue_t* q, uint64_t* enqueued_ns);
+
+
+/**
+ * Instante atual do relógio monotónico em nanossegundos
+ * (a mesma base de tempo de enqueued_ns).
+ */
+uint64_t conn_queue_now_ns(void);
+
+
+/**
+ * Fecha a fila e acorda todos os consumidores bloqueados (shutdown).
+ * Os fds que ainda estejam na fila continuam a poder ser retirados com try_pop.
+ */
+void conn_queue_close(connection_queue_t* q);
+
+
+/**
+ * Maior número de ligações em simultâneo na fila desde o arranque.
+ */
+size_t conn_queue_high_water(connection_queue_t* q);
+
+
+#endif /* CONN_QUEUE_H */
@@ -0,0 +1,416 @@
+#define _GNU_SOURCE  // expõe epoll, MSG_DONTWAIT, getrlimit, etc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "event_loop.h"
+#include "master.h"   // enqueue_connection()
+
+#define EVENT_BATCH      256          // nº máximo de eventos por epoll_wait()
+#define MAX_TRACKED_FDS  (1 << 20)    // limite superior da tabela de ligações
+
+/* Estado global do event loop neste processo */
+static int              g_epfd = -1;                // instância epoll
+static int              g_listen_fd = -1;           // socket de escuta
+static connection_queue_t* g_queue = NULL;          // fila de ligações deste processo
+static shared_data_t*   g_data = NULL;              // memória partilhada (stats)
+static semaphores_t*    g_sems = NULL;              // semáforos
+static int              g_idle_timeout = 30;        // segundos sem atividade até fechar
+static time_t           g_last_sweep = 0;           // último varrimento de timeouts
+
+/* Tabela fd -> ligação. Protegida por g_conns_lock (inserção e remoção). */
+static connection_t**   g_conns = NULL;
+static int              g_conns_size = 0;
+static int              g_max_fd = -1;              // maior fd registado (limita o varrimento)
+static pthread_mutex_t  g_conns_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Ligações estacionadas, da mais antiga para a mais recente: cada uma entra no
+   fim com last_active = agora, por isso o varrimento só olha para o início.
+   Protegida por g_idle_lock (nunca segurado junto com g_conns_lock). */
+static connection_t*    g_idle_head = NULL;
+static connection_t*    g_idle_tail = NULL;
+static pthread_mutex_t  g_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Segundos do relógio monotónico (imune a mudanças da hora do sistema)
+static time_t now_monotonic(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+
+/* Sobe o limite de fds abertos até ao hard limit, para suportar muitas ligações idle. */
+static int raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        return 1024;
+    }
+
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            getrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > MAX_TRACKED_FDS) {
+        return MAX_TRACKED_FDS;
+    }
+    return (int)rl.rlim_cur;
+}
+
+
+/* Tira a ligação da lista de idle. Com g_idle_lock. */
+static void idle_unlink(connection_t* conn) {
+    if (!conn->idle) return;
+    if (conn->idle_prev) conn->idle_prev->idle_next = conn->idle_next;
+    else g_idle_head = conn->idle_next;
+    if (conn->idle_next) conn->idle_next->idle_prev = conn->idle_prev;
+    else g_idle_tail = conn->idle_prev;
+    conn->idle_prev = conn->idle_next = NULL;
+    conn->idle = 0;
+}
+
+
+/* Estaciona a ligação: passa para o fim da lista de idle, ativa agora.
+   Chamar antes de (re)armar o epoll, enquanto ainda somos o dono. */
+static void idle_push(connection_t* conn) {
+    pthread_mutex_lock(&g_idle_lock);
+    idle_unlink(conn);
+    conn->last_active = now_monotonic();
+    conn->idle_prev = g_idle_tail;
+    conn->idle_next = NULL;
+    if (g_idle_tail) g_idle_tail->idle_next = conn;
+    else g_idle_head = conn;
+    g_idle_tail = conn;
+    conn->idle = 1;
+    pthread_mutex_unlock(&g_idle_lock);
+}
+
+
+static void idle_remove(connection_t* conn) {
+    pthread_mutex_lock(&g_idle_lock);
+    idle_unlink(conn);
+    pthread_mutex_unlock(&g_idle_lock);
+}
+
+
+/* Remove a ligação da tabela (não fecha o socket). */
+static void conn_untrack(connection_t* conn) {
+    pthread_mutex_lock(&g_conns_lock);
+    if (conn->fd >= 0 && conn->fd < g_conns_size && g_conns[conn->fd] == conn) {
+        g_conns[conn->fd] = NULL;
+    }
+    pthread_mutex_unlock(&g_conns_lock);
+}
+
+
+/* (Re)arma o epoll para a ligação: EPOLLONESHOT garante um único dono de cada vez. */
+static int conn_arm(connection_t* conn, int op) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    return epoll_ctl(g_epfd, op, conn->fd, &ev);
+}
+
+
+/* Aceita todas as ligações pendentes e regista-as no epoll. */
+static void accept_pending(void) {
+    while (1) {
+        int client_fd = accept(g_listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == ECONNABORTED) continue;
+            // EMFILE/ENFILE/ENOMEM: tentamos de novo na próxima iteração
+            perror("accept");
+            return;
+        }
+
+        if (client_fd >= g_conns_size) {
+            // fora da tabela (não devia acontecer com o limite de fds ajustado)
+            close(client_fd);
+            continue;
+        }
+
+        connection_t* conn = malloc(sizeof(connection_t));
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+        conn->fd = client_fd;
+        conn->len = 0;
+        conn->buf[0] = '\0';
+        http_parser_reset(&conn->parser);
+        conn->idle = 0;
+        conn->idle_prev = conn->idle_next = NULL;
+        atomic_init(&conn->state, CONN_PARKED);
+
+        pthread_mutex_lock(&g_conns_lock);
+        g_conns[client_fd] = conn;
+        if (client_fd > g_max_fd) g_max_fd = client_fd;
+        pthread_mutex_unlock(&g_conns_lock);
+
+        idle_push(conn);
+        if (conn_arm(conn, EPOLL_CTL_ADD) < 0) {
+            perror("epoll_ctl(ADD)");
+            event_loop_close(conn);
+        }
+    }
+}
+
+
+/* Trata uma ligação com dados disponíveis (corre apenas na thread do event loop). */
+static void handle_readable(connection_t* conn) {
+    conn_read_t r = conn_fill(conn);
+
+    if (r == CONN_READ_CLOSED) {
+        event_loop_close(conn);
+        return;
+    }
+
+    if (r == CONN_READ_AGAIN) {
+        // Pedido ainda incompleto: continua estacionada no epoll
+        atomic_store_explicit(&conn->state, CONN_PARKED, memory_order_release);
+        idle_push(conn);
+        if (conn_arm(conn, EPOLL_CTL_MOD) < 0) {
+            event_loop_close(conn);
+        }
+        return;
+    }
+
+    // Pedido completo: entregar ao thread pool
+    event_loop_requeue(conn);
+}
+
+
+/*
+ * Termina ligações estacionadas sem atividade há mais de g_idle_timeout segundos.
+ * Só percorre as expiradas, no início da lista de idle, e não toca em g_conns_lock
+ * (acquire/close não esperam pelo varrimento). Não fechamos aqui diretamente:
+ * shutdown() gera EPOLLHUP e a ligação é fechada pelo caminho normal em
+ * handle_readable(), apenas quando o epoll a tiver armada. Assim nunca libertamos
+ * uma ligação que uma worker thread ainda esteja a rearmar. O socket continua
+ * aberto enquanto está na lista (event_loop_close tira-a antes do close()).
+ */
+static void sweep_idle(time_t now) {
+    if (g_idle_timeout <= 0) return;
+
+    pthread_mutex_lock(&g_idle_lock);
+    while (g_idle_head && now - g_idle_head->last_active >= g_idle_timeout) {
+        connection_t* conn = g_idle_head;
+        idle_unlink(conn);
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&g_idle_lock);
+}
+
+
+int event_loop_init(int listen_fd, connection_queue_t* queue,
+                    shared_data_t* data, semaphores_t* sems, int idle_timeout) {
+    if (listen_fd < 0 || !queue || !data || !sems) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+
+    g_conns_size = raise_fd_limit();
+    g_conns = calloc((size_t)g_conns_size, sizeof(connection_t*));
+    if (!g_conns) {
+        return -1;
+    }
+    g_max_fd = -1;
+
+    g_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_epfd < 0) {
+        free(g_conns);
+        g_conns = NULL;
+        return -1;
+    }
+
+    // Socket de escuta em modo level-triggered: se accept() falhar (EMFILE)
+    // voltamos a ser notificados na próxima iteração.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(g_epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        close(g_epfd);
+        g_epfd = -1;
+        free(g_conns);
+        g_conns = NULL;
+        return -1;
+    }
+
+    g_listen_fd = listen_fd;
+    g_queue = queue;
+    g_data = data;
+    g_sems = sems;
+    g_idle_timeout = idle_timeout;
+    g_last_sweep = now_monotonic();
+    return 0;
+}
+
+
+int event_loop_poll(int timeout_ms) {
+    if (g_epfd < 0) return -1;
+
+    struct epoll_event events[EVENT_BATCH];
+    int n = epoll_wait(g_epfd, events, EVENT_BATCH, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        perror("epoll_wait");
+        return -1;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        connection_t* conn = events[i].data.ptr;
+        if (!conn) {
+            accept_pending();
+        } else {
+            // EPOLLIN, EPOLLRDHUP, EPOLLHUP e EPOLLERR são todos tratados pela leitura
+            handle_readable(conn);
+        }
+    }
+
+    time_t now = now_monotonic();
+    if (now != g_last_sweep) {
+        sweep_idle(now);
+        g_last_sweep = now;
+    }
+    return 0;
+}
+
+
+connection_t* event_loop_acquire(int fd) {
+    if (fd < 0 || fd >= g_conns_size) return NULL;
+
+    pthread_mutex_lock(&g_conns_lock);
+    connection_t* conn = g_conns[fd];
+    pthread_mutex_unlock(&g_conns_lock);
+
+    if (conn) {
+        atomic_store_explicit(&conn->state, CONN_ACTIVE, memory_order_release);
+    }
+    return conn;
+}
+
+
+conn_read_t conn_fill(connection_t* conn) {
+    while (1) {
+        // Pedido completo ou inválido? (ou buffer cheio -> a worker responde 400)
+        if (http_parser_execute(&conn->parser, conn->buf, conn->len) != HTTP_PARSE_AGAIN ||
+            conn->len >= CONN_BUF_SIZE - 1) {
+            return CONN_READ_READY;
+        }
+
+        ssize_t n = recv(conn->fd, conn->buf + conn->len,
+                         CONN_BUF_SIZE - 1 - conn->len, MSG_DONTWAIT);
+        if (n > 0) {
+            conn->len += (size_t)n;
+            conn->buf[conn->len] = '\0';
+            continue;
+        }
+        if (n == 0) {
+            return CONN_READ_CLOSED;  // cliente fechou
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return CONN_READ_AGAIN;
+        }
+        return CONN_READ_CLOSED;
+    }
+}
+
+
+void conn_consume(connection_t* conn, size_t n) {
+    if (n >= conn->len) {
+        conn->len = 0;
+    } else {
+        memmove(conn->buf, conn->buf + n, conn->len - n);
+        conn->len -= n;
+    }
+    conn->buf[conn->len] = '\0';
+    http_parser_reset(&conn->parser);
+}
+
+
+void event_loop_requeue(connection_t* conn) {
+    // Depois do enqueue a ligação pertence a uma worker thread e não lhe podemos tocar
+    int fd = conn->fd;
+    idle_remove(conn);
+    atomic_store_explicit(&conn->state, CONN_QUEUED, memory_order_release);
+    if (enqueue_connection(g_queue, g_data, g_sems, fd) < 0) {
+        // enqueue_connection já enviou 503 e fechou o socket
+        conn_untrack(conn);
+        free(conn);
+    }
+}
+
+
+void event_loop_park(connection_t* conn) {
+    if (!conn) return;
+
+    atomic_store_explicit(&conn->state, CONN_PARKED, memory_order_release);
+    idle_push(conn);
+
+    // Depois de rearmar, o event loop pode tratar (e até fechar) a ligação a
+    // qualquer momento: não voltamos a tocar em conn. Se o rearme falhar, a
+    // ligação nunca mais seria notificada, por isso fechamos já.
+    if (conn_arm(conn, EPOLL_CTL_MOD) < 0) {
+        event_loop_close(conn);
+    }
+}
+
+
+void event_loop_close(connection_t* conn) {
+    if (!conn) return;
+
+    // Retirar da tabela antes do close(): o fd pode ser reutilizado logo a seguir por accept()
+    idle_remove(conn);
+    conn_untrack(conn);
+    close(conn->fd);
+    free(conn);
+}
+
+
+void event_loop_destroy(void) {
+    pthread_mutex_lock(&g_conns_lock);
+    for (int fd = 0; fd <= g_max_fd; ++fd) {
+        connection_t* conn = g_conns[fd];
+        if (!conn) continue;
+        g_conns[fd] = NULL;
+        close(conn->fd);
+        free(conn);
+    }
+    free(g_conns);
+    g_conns = NULL;
+    g_conns_size = 0;
+    g_max_fd = -1;
+    pthread_mutex_unlock(&g_conns_lock);
+
+    pthread_mutex_lock(&g_idle_lock);
+    g_idle_head = g_idle_tail = NULL;
+    pthread_mutex_unlock(&g_idle_lock);
+
+    if (g_epfd >= 0) {
+        close(g_epfd);
+        g_epfd = -1;
+    }
+    g_listen_fd = -1;
+}
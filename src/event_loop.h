@@ -0,0 +1,130 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "shared_mem.h"
+#include "semaphores.h"
+#include "conn_queue.h"
+#include "http_parser.h"
+
+/**
+ * Gestor de ligações orientado a eventos (epoll, edge-triggered).
+ *
+ * As ligações keep-alive inativas ficam "estacionadas" no kernel (epoll) em vez
+ * de ocuparem uma worker thread bloqueada em recv(). O event loop só entrega
+ * uma ligação ao thread pool (via enqueue_connection) quando já tem um pedido
+ * HTTP completo (headers terminados por uma linha vazia) no buffer da ligação.
+ * Cada ligação tem o seu parser incremental: cada byte recebido é analisado
+ * uma só vez, mesmo que o pedido chegue em vários recv().
+ */
+
+#define CONN_BUF_SIZE 8192   // buffer de leitura por ligação (tamanho máximo dos headers)
+
+/* Estados de uma ligação (quem é o "dono" da ligação em cada momento) */
+typedef enum {
+    CONN_PARKED = 0,   // registada no epoll à espera de dados (idle ou pedido incompleto)
+    CONN_QUEUED,       // pedido completo, na fila à espera de uma worker thread
+    CONN_ACTIVE        // a ser tratada por uma worker thread
+} conn_state_t;
+
+/* Resultado de uma leitura não bloqueante para o buffer da ligação */
+typedef enum {
+    CONN_READ_READY = 0,   // há um pedido completo (ou buffer cheio) no buffer
+    CONN_READ_AGAIN,       // ainda faltam dados (EAGAIN)
+    CONN_READ_CLOSED       // cliente fechou a ligação ou erro de leitura
+} conn_read_t;
+
+typedef struct connection {
+    int fd;                     // socket do cliente
+    _Atomic int state;          // conn_state_t
+    time_t last_active;         // última atividade (relógio monotónico, segundos)
+    int idle;                   // 1 enquanto está na lista de idle (estacionada)
+    struct connection* idle_prev;   // lista de idle, por ordem de last_active
+    struct connection* idle_next;
+    size_t len;                 // bytes válidos em buf
+    http_parser_t parser;       // estado do parser do pedido no início de buf
+    char buf[CONN_BUF_SIZE];    // dados recebidos (terminados em '\0')
+} connection_t;
+
+
+/**
+ * Inicializa o event loop deste processo.
+ *
+ * listen_fd    : socket de escuta (passa a não bloqueante)
+ * queue        : fila de ligações do worker process
+ * data, sems   : memória partilhada e semáforos (para enqueue_connection)
+ * idle_timeout : segundos que uma ligação pode ficar estacionada sem atividade
+ *
+ * Retorna 0 em sucesso, -1 em erro.
+ */
+int event_loop_init(int listen_fd, connection_queue_t* queue,
+                    shared_data_t* data, semaphores_t* sems, int idle_timeout);
+
+
+/**
+ * Executa uma iteração do event loop: aceita novas ligações, lê dados das
+ * ligações prontas e entrega pedidos completos ao thread pool. Fecha também
+ * ligações estacionadas há mais de idle_timeout segundos.
+ *
+ * timeout_ms : tempo máximo de espera em epoll_wait().
+ *
+ * Retorna 0 em sucesso (inclui EINTR), -1 em erro fatal.
+ */
+int event_loop_poll(int timeout_ms);
+
+
+/**
+ * Obtém a ligação associada a um fd retirado da fila e marca-a como ativa.
+ * Retorna NULL se o fd não pertence a nenhuma ligação conhecida.
+ */
+connection_t* event_loop_acquire(int fd);
+
+
+/**
+ * Lê (sem bloquear) tudo o que estiver disponível no socket para o buffer
+ * da ligação, até haver um pedido completo. O parser da ligação continua
+ * a análise só sobre os bytes novos. Um pedido mal formado (ou que não cabe
+ * no buffer) também devolve CONN_READ_READY: a worker responde 400.
+ */
+conn_read_t conn_fill(connection_t* conn);
+
+
+/**
+ * Descarta os primeiros n bytes do buffer (o pedido já tratado).
+ * Os bytes seguintes (pedidos em pipeline) passam para o início do buffer
+ * e o parser recomeça no início do pedido seguinte.
+ */
+void conn_consume(connection_t* conn, size_t n);
+
+
+/**
+ * Volta a pôr na fila uma ligação que já tem um pedido completo no buffer
+ * (pipelining), sem passar pelo epoll. Se a fila estiver cheia, a ligação
+ * recebe 503 e é fechada. A worker thread deixa de poder usar a ligação.
+ */
+void event_loop_requeue(connection_t* conn);
+
+
+/**
+ * Devolve uma ligação keep-alive ao event loop (rearma o epoll).
+ * A worker thread deixa de poder usar a ligação após esta chamada.
+ */
+void event_loop_park(connection_t* conn);
+
+
+/**
+ * Fecha o socket e liberta a ligação.
+ */
+void event_loop_close(connection_t* conn);
+
+
+/**
+ * Fecha todas as ligações ainda abertas e liberta o event loop.
+ * Deve ser chamada depois de todas as worker threads terminarem.
+ */
+void event_loop_destroy(void);
+
+
+#endif /* EVENT_LOOP_H */
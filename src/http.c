@@ -1,49 +1,279 @@
+#define _GNU_SOURCE     // strptime(), timegm()
+
 #include "http.h"
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <time.h>
+#include <pthread.h>
 #include <semaphore.h>
 
-int parse_http_request(const char* buffer, http_request_t* req) {
-    char* line_end = strstr(buffer, "\r\n");
-    if (!line_end) return -1;
+#define SEND_TIMEOUT_MS 30000   // espera máxima por espaço no buffer de envio (EAGAIN)
 
-    char first_line[1024];
-    size_t len = line_end - buffer;
-    strncpy(first_line, buffer, len);
-    first_line[len] = '\0';
+static int g_tcp_cork = 0;      // política TCP_CORK (http_set_tcp_cork)
 
-    if (sscanf(first_line, "%s %s %s", req->method, req->path, req->version) != 3) {
-        return -1;
+void http_set_tcp_cork(int enabled) {
+    g_tcp_cork = enabled ? 1 : 0;
+}
+
+/* IMF-fixdate (RFC 9110), sempre em GMT */
+#define HTTP_DATE_FORMAT "%a, %d %b %Y %H:%M:%S GMT"
+
+/* Linhas ETag, Last-Modified e Vary para "%s%s%s%s%s%s%s" (vazias sem validadores) */
+#define VALIDATOR_LINES(v) \
+    (v) ? "ETag: " : "", (v) ? (v)->etag : "", (v) ? "\r\n" : "", \
+    (v) ? "Last-Modified: " : "", (v) ? (v)->last_modified : "", (v) ? "\r\n" : "", \
+    ((v) && (v)->vary_encoding) ? "Vary: Accept-Encoding\r\n" : ""
+
+void http_format_validators(http_validators_t* v, uint64_t ino, size_t size, int64_t mtime_ns) {
+    snprintf(v->etag, sizeof(v->etag), "\"%" PRIx64 "-%zx-%" PRIx64 "\"",
+             ino, size, (uint64_t)mtime_ns);
+
+    struct tm tm;
+    time_t secs = (time_t)(mtime_ns / 1000000000LL);
+    if (!gmtime_r(&secs, &tm) ||
+        strftime(v->last_modified, sizeof(v->last_modified), HTTP_DATE_FORMAT, &tm) == 0) {
+        v->last_modified[0] = '\0';
+    }
+    v->vary_encoding = 0;
+}
+
+int http_accepts_gzip(const char* value, size_t len) {
+    int star = 0;
+    const char* end = value + len;
+    const char* p = value;
+    while (p < end) {
+        // Um elemento da lista: "codificação[;q=valor]"
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+        const char* name = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+        size_t name_len = (size_t)(p - name);
+
+        int q_zero = 0;
+        while (p < end && *p != ',') {
+            if ((*p == 'q' || *p == 'Q') && p + 1 < end && p[1] == '=') {
+                // q=0, q=0.0, q=0.00, q=0.000
+                const char* q = p + 2;
+                q_zero = (q < end && *q == '0');
+                for (q++; q_zero && q < end && *q != ',' && *q != ';' && *q != ' '; q++) {
+                    if (*q != '.' && *q != '0') q_zero = 0;
+                }
+            }
+            p++;
+        }
+
+        if ((name_len == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+            (name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+            return !q_zero;             // explícito: decide, com ou sem "*"
+        }
+        if (name_len == 1 && *name == '*') star = !q_zero;
     }
+    return star;
+}
+
+/* 1 se a lista de If-None-Match tem "*" ou uma ETag igual a etag (ignorando "W/") */
+static int etag_list_matches(const char* list, const char* etag) {
+    size_t etag_len = strlen(etag);
+    const char* p = list;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (*p == '\0') break;
+        if (*p == '*') return 1;
+        if (p[0] == 'W' && p[1] == '/') p += 2;
+        if (*p != '"') return 0;                // mal formado: como se não correspondesse
 
+        const char* end = strchr(p + 1, '"');
+        if (!end) return 0;
+        if ((size_t)(end + 1 - p) == etag_len && memcmp(p, etag, etag_len) == 0) return 1;
+        p = end + 1;
+    }
     return 0;
 }
 
-void send_http_response(int client_fd, int status_code, const char* status_msg,
-    const char* content_type, const char* body, size_t
-    body_len, int keep_alive) {
-    char header[2048];
-    int header_len = snprintf(header, sizeof(header),
+int http_not_modified(const char* if_none_match, const char* if_modified_since,
+                      const http_validators_t* v, int64_t mtime_ns) {
+    if (!v) return 0;
+    if (if_none_match) {
+        return etag_list_matches(if_none_match, v->etag);   // If-Modified-Since é ignorado
+    }
+    if (if_modified_since) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char* end = strptime(if_modified_since, HTTP_DATE_FORMAT, &tm);
+        if (!end || *end != '\0') return 0;    // data inválida (ou formato obsoleto): 200 normal
+        return mtime_ns / 1000000000LL <= (int64_t)timegm(&tm);
+    }
+    return 0;
+}
+
+int http_format_header(char* header, size_t header_sz, int status_code,
+    const char* status_msg, const char* content_type, const char* content_encoding,
+    const http_validators_t* validators, size_t body_len, int keep_alive) {
+    return snprintf(header, header_sz,
         "HTTP/1.1 %d %s\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %zu\r\n"
+        "%s%s%s"
+        "%s%s%s%s%s%s%s"
         "Accept-Ranges: bytes\r\n"
         "Server: ConcurrentHTTP/1.0\r\n"
         "Connection: %s\r\n"
         "\r\n",
         status_code, status_msg, content_type, body_len,
+        content_encoding ? "Content-Encoding: " : "", content_encoding ? content_encoding : "",
+        content_encoding ? "\r\n" : "",
+        VALIDATOR_LINES(validators),
         keep_alive ? "keep-alive" : "close");
+}
 
-    send(client_fd, header, header_len, 0);
+int http_format_not_modified(char* header, size_t header_sz, const http_validators_t* validators,
+    int keep_alive) {
+    return snprintf(header, header_sz,
+        "HTTP/1.1 304 Not Modified\r\n"
+        "%s%s%s%s%s%s%s"
+        "Server: ConcurrentHTTP/1.0\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        VALIDATOR_LINES(validators),
+        keep_alive ? "keep-alive" : "close");
+}
 
-    if (body && body_len > 0) {
-        send(client_fd, body, body_len, 0);
+/* Formata o cabeçalho de uma resposta 206 Partial Content. Retorna o tamanho. */
+static int format_range_header(char* header, size_t header_sz, const char* content_type,
+    const http_validators_t* validators, size_t total_size, long range_start, long range_end,
+    int keep_alive) {
+    size_t content_length = range_end - range_start + 1;
+    return snprintf(header, header_sz,
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Content-Range: bytes %ld-%ld/%zu\r\n"
+        "%s%s%s%s%s%s%s"
+        "Accept-Ranges: bytes\r\n"
+        "Server: ConcurrentHTTP/1.0\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        content_type, content_length, range_start, range_end, total_size,
+        VALIDATOR_LINES(validators),
+        keep_alive ? "keep-alive" : "close");
+}
+
+/* Espera que o socket volte a ter espaço no buffer de envio. Retorna 0 ou -1 (timeout/erro). */
+static int wait_writable(int client_fd) {
+    struct pollfd pfd = { .fd = client_fd, .events = POLLOUT };
+    int r;
+    do {
+        r = poll(&pfd, 1, SEND_TIMEOUT_MS);
+    } while (r < 0 && errno == EINTR);
+    return (r > 0 && !(pfd.revents & (POLLERR | POLLNVAL))) ? 0 : -1;
+}
+
+/*
+ * Envia todos os buffers de iov com o mínimo de syscalls (sendmsg = writev
+ * com flags). Em envios parciais avança o iov e continua de onde parou.
+ * flags: MSG_MORE quando vai seguir-se mais dados (ex: corpo via sendfile).
+ * Retorna 0 em sucesso, -1 em erro (cliente fechou, timeout, ...).
+ */
+static int send_all_iov(int client_fd, struct iovec* iov, int iovcnt, int flags) {
+    // Ignorar buffers vazios no início (sendmsg com tudo vazio não avança)
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        iov++;
+        iovcnt--;
+    }
+
+    while (iovcnt > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)iovcnt };
+        ssize_t n = sendmsg(client_fd, &msg, flags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(client_fd) == 0) continue;
+            return -1;
+        }
+
+        // Avançar sobre o que já foi enviado
+        size_t sent = (size_t)n;
+        while (iovcnt > 0 && sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Envia len bytes do ficheiro a partir de offset diretamente do page cache
+ * para o socket (sendfile), sem copiar os dados para userspace.
+ * Retorna 0 em sucesso, -1 em erro (cliente fechou, ficheiro encolheu, ...).
+ */
+static int send_file_body(int client_fd, int file_fd, off_t offset, size_t len) {
+    while (len > 0) {
+        ssize_t n = sendfile(client_fd, file_fd, &offset, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(client_fd) == 0) continue;
+            return -1;
+        }
+        if (n == 0) {
+            return -1;  // fim do ficheiro antes do esperado
+        }
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Header + corpo via sendfile. Com TCP_CORK o kernel só envia segmentos
+ * cheios até ao "uncork"; sem ele, MSG_MORE no header tem o mesmo efeito
+ * para o primeiro segmento (o header não sai sozinho num pacote pequeno).
+ */
+static int send_header_and_file(int client_fd, char* header, int header_len,
+                                int file_fd, off_t offset, size_t len) {
+    int on = 1, off = 0;
+    if (g_tcp_cork) {
+        setsockopt(client_fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+    }
+
+    struct iovec iov = { .iov_base = header, .iov_len = (size_t)header_len };
+    int rc = send_all_iov(client_fd, &iov, 1, (len > 0 && !g_tcp_cork) ? MSG_MORE : 0);
+    if (rc == 0) {
+        rc = send_file_body(client_fd, file_fd, offset, len);
+    }
+
+    if (g_tcp_cork) {
+        setsockopt(client_fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
     }
+    return rc;
+}
+
+int send_http_response(int client_fd, int status_code, const char* status_msg,
+    const char* content_type, const http_validators_t* validators, const char* body, size_t
+    body_len, int keep_alive) {
+    char header[2048];
+    int header_len = http_format_header(header, sizeof(header), status_code, status_msg,
+        content_type, NULL, validators, body_len, keep_alive);
+
+    // Header e corpo num só sendmsg: ficheiros pequenos saem num único segmento TCP
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = (size_t)header_len },
+        { .iov_base = (void*)body, .iov_len = body ? body_len : 0 }
+    };
+    return send_all_iov(client_fd, iov, 2, 0);
 }
 
 void log_request(sem_t* log_sem, const char* client_ip, const char* method,
@@ -116,8 +346,9 @@ int parse_range_header(const char* range_value, range_request_t* range, size_t f
     return 0;
 }
 
-void send_http_response_range(int client_fd,
+int send_http_response_range(int client_fd,
                                const char* content_type,
+                               const http_validators_t* validators,
                                const char* body,
                                size_t total_size,
                                long range_start,
@@ -126,21 +357,138 @@ void send_http_response_range(int client_fd,
     size_t content_length = range_end - range_start + 1;
 
     char header[2048];
-    int header_len = snprintf(header, sizeof(header),
-        "HTTP/1.1 206 Partial Content\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Content-Range: bytes %ld-%ld/%zu\r\n"
-        "Accept-Ranges: bytes\r\n"
-        "Server: ConcurrentHTTP/1.0\r\n"
-        "Connection: %s\r\n"
-        "\r\n",
-        content_type, content_length, range_start, range_end, total_size,
-        keep_alive ? "keep-alive" : "close");
+    int header_len = format_range_header(header, sizeof(header), content_type, validators,
+        total_size, range_start, range_end, keep_alive);
+
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = (size_t)header_len },
+        { .iov_base = body ? (void*)(body + range_start) : NULL, .iov_len = body ? content_length : 0 }
+    };
+    return send_all_iov(client_fd, iov, 2, 0);
+}
 
-    send(client_fd, header, header_len, 0);
+int send_http_response_file(int client_fd, int status_code, const char* status_msg,
+    const char* content_type, const http_validators_t* validators, int file_fd, size_t file_size,
+    int keep_alive) {
+    char header[2048];
+    int header_len = http_format_header(header, sizeof(header), status_code, status_msg,
+        content_type, NULL, validators, file_size, keep_alive);
+
+    return send_header_and_file(client_fd, header, header_len, file_fd, 0, file_size);
+}
+
+int send_http_response_range_file(int client_fd, const char* content_type,
+    const http_validators_t* validators, int file_fd, size_t total_size, long range_start,
+    long range_end, int keep_alive) {
+    size_t content_length = range_end - range_start + 1;
+
+    char header[2048];
+    int header_len = format_range_header(header, sizeof(header), content_type, validators,
+        total_size, range_start, range_end, keep_alive);
 
-    if (body && content_length > 0) {
-        send(client_fd, body + range_start, content_length, 0);
+    return send_header_and_file(client_fd, header, header_len, file_fd,
+                                (off_t)range_start, content_length);
+}
+
+/* Copia header + corpo para o fim do batch, se couberem. */
+static int batch_append(http_batch_t* batch, int header_len, const char* body, size_t body_len) {
+    size_t room = HTTP_BATCH_SIZE - batch->len;
+    if (header_len < 0 || (size_t)header_len >= room || body_len > room - (size_t)header_len) {
+        return -1;
+    }
+    if (body && body_len > 0) {
+        memcpy(batch->data + batch->len + header_len, body, body_len);
+    }
+    batch->len += (size_t)header_len + body_len;
+    return 0;
+}
+
+int http_batch_response(http_batch_t* batch, int status_code, const char* status_msg,
+    const char* content_type, const http_validators_t* validators, const char* body,
+    size_t body_len, int keep_alive) {
+    // O header é formatado diretamente no batch (só conta se o corpo também couber)
+    int header_len = http_format_header(batch->data + batch->len, HTTP_BATCH_SIZE - batch->len,
+        status_code, status_msg, content_type, NULL, validators, body_len, keep_alive);
+    return batch_append(batch, header_len, body, body ? body_len : 0);
+}
+
+int http_batch_response_range(http_batch_t* batch, const char* content_type,
+    const http_validators_t* validators, const char* body, size_t total_size, long range_start,
+    long range_end, int keep_alive) {
+    size_t content_length = range_end - range_start + 1;
+    int header_len = format_range_header(batch->data + batch->len, HTTP_BATCH_SIZE - batch->len,
+        content_type, validators, total_size, range_start, range_end, keep_alive);
+    return batch_append(batch, header_len, body ? body + range_start : NULL, body ? content_length : 0);
+}
+
+int send_http_preformatted(int client_fd, const char* header, size_t header_len,
+                           const char* body, size_t body_len) {
+    // Header guardado mesmo antes do corpo: um só buffer
+    if (body && header + header_len == body) {
+        struct iovec iov = { .iov_base = (void*)header, .iov_len = header_len + body_len };
+        return send_all_iov(client_fd, &iov, 1, 0);
+    }
+    struct iovec iov[2] = {
+        { .iov_base = (void*)header, .iov_len = header_len },
+        { .iov_base = (void*)body, .iov_len = body ? body_len : 0 }
+    };
+    return send_all_iov(client_fd, iov, 2, 0);
+}
+
+int http_batch_preformatted(http_batch_t* batch, const char* header, size_t header_len,
+                            const char* body, size_t body_len) {
+    if (header_len >= HTTP_BATCH_SIZE - batch->len) {
+        return -1;
+    }
+    memcpy(batch->data + batch->len, header, header_len);
+    return batch_append(batch, (int)header_len, body, body ? body_len : 0);
+}
+
+
+/* Respostas de erro fixas, formatadas uma vez por processo */
+static const struct {
+    int status_code;
+    const char* status_msg;
+    const char* body;
+} g_error_specs[HTTP_ERR_COUNT] = {
+    [HTTP_ERR_400] = { 400, "Bad Request", "<html><body><h1>400 Bad Request</h1></body></html>" },
+    [HTTP_ERR_404] = { 404, "Not Found", "<html><body><h1>404 Not Found</h1></body></html>" },
+    [HTTP_ERR_405] = { 405, "Method Not Allowed", "<html><body><h1>405 Method Not Allowed</h1></body></html>" },
+    [HTTP_ERR_416] = { 416, "Range Not Satisfiable",
+                       "<html><body><h1>416 Range Not Satisfiable</h1></body></html>" },
+    [HTTP_ERR_503] = { 503, "Service Unavailable",
+                       "<html><body><h1>503 Service Unavailable</h1>"
+                       "<p>Server is overloaded, please try again later.</p>"
+                       "</body></html>" },
+};
+
+static char g_error_data[HTTP_ERR_COUNT][512];
+static http_blob_t g_error_blobs[HTTP_ERR_COUNT];
+static pthread_once_t g_error_once = PTHREAD_ONCE_INIT;
+
+static void build_error_blobs(void) {
+    for (int i = 0; i < HTTP_ERR_COUNT; ++i) {
+        size_t body_len = strlen(g_error_specs[i].body);
+        int header_len = http_format_header(g_error_data[i], sizeof(g_error_data[i]),
+            g_error_specs[i].status_code, g_error_specs[i].status_msg, "text/html", NULL, NULL, body_len, 0);
+        memcpy(g_error_data[i] + header_len, g_error_specs[i].body, body_len);
+        g_error_blobs[i].data = g_error_data[i];
+        g_error_blobs[i].len = (size_t)header_len + body_len;
+        g_error_blobs[i].body_len = body_len;
+        g_error_blobs[i].status_code = g_error_specs[i].status_code;
+    }
+}
+
+const http_blob_t* http_error_response(http_error_t err) {
+    pthread_once(&g_error_once, build_error_blobs);
+    return &g_error_blobs[err];
+}
+
+int http_batch_flush(int client_fd, http_batch_t* batch) {
+    if (batch->len == 0) {
+        return 0;
     }
+    struct iovec iov = { .iov_base = batch->data, .iov_len = batch->len };
+    batch->len = 0;
+    return send_all_iov(client_fd, &iov, 1, 0);
 }
@@ -2,12 +2,16 @@
 #define HTTP_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <semaphore.h>
 
 #define MAX_METHOD_LEN 16
 #define MAX_PATH_LEN   512
 #define MAX_VERSION_LEN 16
+#define HTTP_BATCH_SIZE (64 * 1024)   // respostas acumuladas antes de um único envio (pipelining)
+#define HTTP_ETAG_MAX   64            // "inode-tamanho-mtime" em hex, com aspas
+#define HTTP_DATE_MAX   32            // "Sun, 06 Nov 1994 08:49:37 GMT"
 
 typedef struct {
     char method[MAX_METHOD_LEN];
@@ -15,6 +19,15 @@ typedef struct {
     char version[MAX_VERSION_LEN];
 } http_request_t;
 
+/*
+ * Respostas acumuladas para pedidos em pipeline: são copiadas para data e
+ * enviadas todas juntas, por ordem, com um só send (http_batch_flush).
+ */
+typedef struct {
+    size_t len;
+    char data[HTTP_BATCH_SIZE];
+} http_batch_t;
+
 typedef struct {
     int has_range;
     long start;
@@ -22,26 +35,168 @@ typedef struct {
     int is_suffix_range;
 } range_request_t;
 
-int parse_http_request(const char* buffer, http_request_t* req);
-
 int parse_range_header(const char* range_value, range_request_t* range, size_t file_size);
 
-void send_http_response_range(int client_fd,
-                               const char* content_type,
-                               const char* body,
-                               size_t total_size,
-                               long range_start,
-                               long range_end,
-                               int keep_alive);
+/*
+ * Validadores de um ficheiro para pedidos condicionais: ETag forte (inode,
+ * tamanho e mtime) e Last-Modified. Formatados uma vez, quando o ficheiro
+ * entra no cache, e guardados com a entrada. vary_encoding acrescenta
+ * "Vary: Accept-Encoding" (o ficheiro pode ter uma variante gzip), para os
+ * caches intermédios guardarem as duas versões em separado.
+ */
+typedef struct {
+    char etag[HTTP_ETAG_MAX];
+    char last_modified[HTTP_DATE_MAX];
+    int vary_encoding;
+} http_validators_t;
+
+void http_format_validators(http_validators_t* v, uint64_t ino, size_t size, int64_t mtime_ns);
+
+/*
+ * 1 se o valor de Accept-Encoding (len bytes, sem '\0') aceita gzip: "gzip",
+ * "x-gzip" ou "*" sem q=0.
+ */
+int http_accepts_gzip(const char* value, size_t len);
+
+/*
+ * 1 se o pedido condicional pode ser respondido com 304 Not Modified: com
+ * If-None-Match, se alguma das ETags (comparação fraca) ou "*" corresponde;
+ * só sem ele, se o ficheiro não mudou desde If-Modified-Since. Os valores
+ * dos headers são NULL quando ausentes.
+ */
+int http_not_modified(const char* if_none_match, const char* if_modified_since,
+                      const http_validators_t* v, int64_t mtime_ns);
+
+/*
+ * Formata o cabeçalho de uma resposta completa (200, erros, ...) em header,
+ * com ETag e Last-Modified se validators não for NULL e Content-Encoding se
+ * content_encoding não for NULL.
+ * Retorna o tamanho (>= header_sz se não coube, como o snprintf).
+ */
+int http_format_header(char* header, size_t header_sz, int status_code, const char* status_msg,
+                       const char* content_type, const char* content_encoding,
+                       const http_validators_t* validators, size_t body_len, int keep_alive);
+
+/*
+ * Formata uma resposta 304 Not Modified (só header, sem corpo).
+ */
+int http_format_not_modified(char* header, size_t header_sz, const http_validators_t* validators,
+                             int keep_alive);
+
+/*
+ * Respostas de erro fixas (header com "Connection: close" + corpo HTML),
+ * formatadas uma só vez por processo e enviadas tal como estão.
+ */
+typedef enum {
+    HTTP_ERR_400 = 0,
+    HTTP_ERR_404,
+    HTTP_ERR_405,
+    HTTP_ERR_416,
+    HTTP_ERR_503,
+    HTTP_ERR_COUNT
+} http_error_t;
+
+typedef struct {
+    const char* data;       // header + corpo, contíguos
+    size_t len;
+    size_t body_len;        // só o corpo (é o que as estatísticas contam)
+    int status_code;
+} http_blob_t;
+
+const http_blob_t* http_error_response(http_error_t err);
+
+/*
+ * Funções de envio de respostas: header e corpo seguem no mesmo sendmsg()
+ * (writev), com ciclo para envios parciais. Retornam 0 se a resposta foi
+ * enviada por completo, -1 em erro (o chamador deve fechar a ligação).
+ */
+int send_http_response_range(int client_fd,
+                             const char* content_type,
+                             const http_validators_t* validators,
+                             const char* body,
+                             size_t total_size,
+                             long range_start,
+                             long range_end,
+                             int keep_alive);
+
+int send_http_response(int client_fd,
+                       int status_code,
+                       const char* status_msg,
+                       const char* content_type,
+                       const http_validators_t* validators,
+                       const char* body,
+                       size_t body_len,
+                       int keep_alive);
+
+/*
+ * Variantes para ficheiros grandes que não estão em memória: o corpo é
+ * enviado com sendfile() a partir de file_fd (sem cópia para userspace).
+ * A versão range envia só [range_start, range_end] (206 Partial Content).
+ */
+int send_http_response_file(int client_fd,
+                            int status_code,
+                            const char* status_msg,
+                            const char* content_type,
+                            const http_validators_t* validators,
+                            int file_fd,
+                            size_t file_size,
+                            int keep_alive);
+
+int send_http_response_range_file(int client_fd,
+                                  const char* content_type,
+                                  const http_validators_t* validators,
+                                  int file_fd,
+                                  size_t total_size,
+                                  long range_start,
+                                  long range_end,
+                                  int keep_alive);
 
-void send_http_response(int client_fd,
+/*
+ * Acrescenta uma resposta completa (200/206/erros) ao batch, em vez de a enviar.
+ * Retorna 0 se coube, -1 se não há espaço (o batch fica inalterado).
+ */
+int http_batch_response(http_batch_t* batch,
                         int status_code,
                         const char* status_msg,
                         const char* content_type,
+                        const http_validators_t* validators,
                         const char* body,
                         size_t body_len,
                         int keep_alive);
 
+int http_batch_response_range(http_batch_t* batch,
+                              const char* content_type,
+                              const http_validators_t* validators,
+                              const char* body,
+                              size_t total_size,
+                              long range_start,
+                              long range_end,
+                              int keep_alive);
+
+/*
+ * Resposta com o header já formatado (p.ex. guardado com a entrada do cache):
+ * sem snprintf, e um só buffer quando o header está mesmo antes do corpo.
+ * A versão batch copia-a para o batch (-1 se não couber, batch inalterado).
+ */
+int send_http_preformatted(int client_fd, const char* header, size_t header_len,
+                           const char* body, size_t body_len);
+
+int http_batch_preformatted(http_batch_t* batch, const char* header, size_t header_len,
+                            const char* body, size_t body_len);
+
+/*
+ * Envia todas as respostas acumuladas no batch (um sendmsg) e esvazia-o.
+ * Retorna 0 em sucesso (ou batch vazio), -1 em erro.
+ */
+int http_batch_flush(int client_fd, http_batch_t* batch);
+
+/*
+ * Política TCP_CORK para respostas com sendfile (TCP_CORK no server.conf):
+ * com enabled != 0 o socket fica "corked" entre o header e o fim do corpo,
+ * para o kernel só enviar segmentos cheios. Chamar uma vez no arranque.
+ */
+void http_set_tcp_cork(int enabled);
+
 void log_request(sem_t* log_sem, const char* client_ip, const char* method, const char* path, int status, size_t bytes);
 
 #endif 
@@ -0,0 +1,340 @@
+#include <string.h>
+
+#include "http_parser.h"
+#include "simd_scan.h"
+
+#define MAX_METHOD_TOKEN 16   // métodos maiores do que isto são rejeitados
+
+/* Estados da máquina */
+enum {
+    ST_METHOD = 0,     // método (aceita linhas vazias antes do pedido)
+    ST_PATH_START,     // primeiro byte do path
+    ST_PATH,           // path até ao espaço
+    ST_VERSION,        // "HTTP/1.x" até ao fim da linha
+    ST_REQ_LF,         // '\n' depois do '\r' da request line
+    ST_LINE_START,     // início de uma linha de header (ou linha vazia)
+    ST_NAME,           // nome do header até ':'
+    ST_VALUE_START,    // espaços antes do valor
+    ST_VALUE,          // valor até ao fim da linha
+    ST_HDR_LF,         // '\n' depois do '\r' de um header
+    ST_END_LF,         // '\n' da linha vazia final
+    ST_DONE,
+    ST_ERROR
+};
+
+/* Nomes dos headers guardados na tabela (índice = http_header_id_t) */
+static const struct {
+    const char* name;
+    uint32_t len;
+} k_headers[HTTP_HDR_COUNT] = {
+    [HTTP_HDR_HOST]              = { "host", 4 },
+    [HTTP_HDR_CONNECTION]        = { "connection", 10 },
+    [HTTP_HDR_RANGE]             = { "range", 5 },
+    [HTTP_HDR_IF_NONE_MATCH]     = { "if-none-match", 13 },
+    [HTTP_HDR_IF_MODIFIED_SINCE] = { "if-modified-since", 17 },
+    [HTTP_HDR_ACCEPT_ENCODING]   = { "accept-encoding", 15 },
+    [HTTP_HDR_USER_AGENT]        = { "user-agent", 10 },
+    [HTTP_HDR_CONTENT_LENGTH]    = { "content-length", 14 },
+    [HTTP_HDR_TRANSFER_ENCODING] = { "transfer-encoding", 17 },
+};
+
+static const struct {
+    const char* name;
+    uint32_t len;
+    http_method_t method;
+} k_methods[] = {
+    { "GET", 3, HTTP_METHOD_GET },
+    { "HEAD", 4, HTTP_METHOD_HEAD },
+    { "POST", 4, HTTP_METHOD_POST },
+    { "PUT", 3, HTTP_METHOD_PUT },
+    { "DELETE", 6, HTTP_METHOD_DELETE },
+    { "OPTIONS", 7, HTTP_METHOD_OPTIONS },
+};
+
+
+/* tchar do RFC 9110: caracteres válidos em métodos e nomes de headers */
+static const unsigned char k_tchar[256] = {
+    ['a' ... 'z'] = 1, ['A' ... 'Z'] = 1, ['0' ... '9'] = 1,
+    ['!'] = 1, ['#'] = 1, ['$'] = 1, ['%'] = 1, ['&'] = 1, ['\''] = 1,
+    ['*'] = 1, ['+'] = 1, ['-'] = 1, ['.'] = 1, ['^'] = 1, ['_'] = 1,
+    ['`'] = 1, ['|'] = 1, ['~'] = 1,
+};
+
+
+static int lower_ascii(int c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static int is_token_char(unsigned char c) {
+    return k_tchar[c];
+}
+
+static int is_ctl(unsigned char c) {
+    return c < 0x20 || c == 0x7f;
+}
+
+/* O nome só tem tchars (validado em ST_NAME), por isso a comparação SIMD é exata */
+static int lookup_header(const char* name, uint32_t len) {
+    for (int i = 0; i < HTTP_HDR_COUNT; ++i) {
+        if (k_headers[i].len == len && simd_equals_lower(name, k_headers[i].name, len)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static http_method_t lookup_method(const char* name, uint32_t len) {
+    // Métodos são case-sensitive
+    for (size_t i = 0; i < sizeof(k_methods) / sizeof(k_methods[0]); ++i) {
+        if (k_methods[i].len == len && memcmp(name, k_methods[i].name, len) == 0) {
+            return k_methods[i].method;
+        }
+    }
+    return HTTP_METHOD_OTHER;
+}
+
+/* Valida "HTTP/1.x" e guarda a versão. Retorna 0 ou -1. */
+static int finish_version(http_parser_t* p, const char* buf, uint32_t end) {
+    p->version.off = p->mark;
+    p->version.len = end - p->mark;
+    const char* v = buf + p->mark;
+    if (p->version.len != 8 || memcmp(v, "HTTP/1.", 7) != 0 || v[7] < '0' || v[7] > '9') {
+        return -1;
+    }
+    p->version_minor = v[7] - '0';
+    return 0;
+}
+
+/* Guarda o valor do header atual (sem espaços finais). O primeiro valor ganha,
+   exceto nos headers que definem o tamanho do pedido: aí um valor vazio ou
+   repetido é um erro (-1). */
+static int finish_value(http_parser_t* p, const char* buf, uint32_t end) {
+    if (p->cur_header < 0) return 0;
+
+    while (end > p->mark && (buf[end - 1] == ' ' || buf[end - 1] == '\t')) {
+        end--;
+    }
+    http_slice_t* s = &p->headers[p->cur_header];
+    int framing = (p->cur_header == HTTP_HDR_CONTENT_LENGTH ||
+                   p->cur_header == HTTP_HDR_TRANSFER_ENCODING);
+    if (framing && (s->len != 0 || end == p->mark)) {
+        return -1;
+    }
+    if (s->len == 0) {
+        s->off = p->mark;
+        s->len = end - p->mark;
+    }
+    return 0;
+}
+
+
+void http_parser_reset(http_parser_t* p) {
+    memset(p, 0, sizeof(*p));
+    p->state = ST_METHOD;
+    p->cur_header = -1;
+}
+
+
+http_parse_result_t http_parser_execute(http_parser_t* p, const char* buf, size_t len) {
+    uint32_t pos = p->pos;
+    int state = p->state;
+
+    while (pos < len && state != ST_DONE && state != ST_ERROR) {
+        // Path, nomes e valores de headers são a maior parte do pedido: em vez de
+        // um byte por iteração, saltar até ao próximo byte que muda de estado
+        if (state == ST_VALUE) {
+            pos += (uint32_t)simd_find_ctl(buf + pos, len - pos);
+        } else if (state == ST_PATH) {
+            pos += (uint32_t)simd_find_ctl_or_space(buf + pos, len - pos);
+        } else if (state == ST_NAME) {
+            while (pos < len && k_tchar[(unsigned char)buf[pos]]) pos++;
+        }
+        if (pos >= len) break;
+
+        unsigned char c = (unsigned char)buf[pos];
+
+        switch (state) {
+        case ST_METHOD:
+            if (is_token_char(c)) {
+                if (pos - p->mark >= MAX_METHOD_TOKEN) state = ST_ERROR;
+                break;
+            }
+            if ((c == '\r' || c == '\n') && pos == p->mark) {
+                p->mark = pos + 1;        // linhas vazias antes do pedido são ignoradas
+                break;
+            }
+            if (c != ' ' || pos == p->mark) {
+                state = ST_ERROR;
+                break;
+            }
+            p->method_str.off = p->mark;
+            p->method_str.len = pos - p->mark;
+            p->method = lookup_method(buf + p->mark, p->method_str.len);
+            state = ST_PATH_START;
+            break;
+
+        case ST_PATH_START:
+            if (c == ' ' || is_ctl(c)) {
+                state = ST_ERROR;
+                break;
+            }
+            p->mark = pos;
+            state = ST_PATH;
+            break;
+
+        case ST_PATH:
+            if (c == ' ') {
+                p->path.off = p->mark;
+                p->path.len = pos - p->mark;
+                p->mark = pos + 1;
+                state = ST_VERSION;
+            } else if (is_ctl(c)) {
+                state = ST_ERROR;
+            }
+            break;
+
+        case ST_VERSION:
+            if (c == '\r' || c == '\n') {
+                if (finish_version(p, buf, pos) < 0) {
+                    state = ST_ERROR;
+                } else {
+                    state = (c == '\r') ? ST_REQ_LF : ST_LINE_START;
+                }
+            } else if (pos - p->mark >= 8) {
+                state = ST_ERROR;
+            }
+            break;
+
+        case ST_REQ_LF:
+        case ST_HDR_LF:
+            state = (c == '\n') ? ST_LINE_START : ST_ERROR;
+            break;
+
+        case ST_LINE_START:
+            if (c == '\r') {
+                state = ST_END_LF;
+            } else if (c == '\n') {
+                p->header_len = pos + 1;
+                state = ST_DONE;
+            } else if (is_token_char(c)) {
+                p->mark = pos;
+                state = ST_NAME;
+            } else {
+                state = ST_ERROR;     // inclui obs-fold (linha a começar por espaço)
+            }
+            break;
+
+        case ST_NAME:
+            if (c == ':') {
+                if (pos == p->mark) {
+                    state = ST_ERROR;
+                    break;
+                }
+                p->cur_header = lookup_header(buf + p->mark, pos - p->mark);
+                state = ST_VALUE_START;
+            } else if (!is_token_char(c)) {
+                state = ST_ERROR;
+            }
+            break;
+
+        case ST_VALUE_START:
+            if (c == ' ' || c == '\t') {
+                break;
+            }
+            p->mark = pos;
+            state = ST_VALUE;
+            // fall through - este byte já pertence ao valor
+        case ST_VALUE:
+            if (c == '\r' || c == '\n') {
+                int rc = finish_value(p, buf, pos);
+                p->cur_header = -1;
+                if (rc < 0) {
+                    state = ST_ERROR;
+                    break;
+                }
+                state = (c == '\r') ? ST_HDR_LF : ST_LINE_START;
+            } else if (is_ctl(c) && c != '\t') {
+                state = ST_ERROR;
+            }
+            break;
+
+        case ST_END_LF:
+            if (c == '\n') {
+                p->header_len = pos + 1;
+                state = ST_DONE;
+            } else {
+                state = ST_ERROR;
+            }
+            break;
+        }
+
+        pos++;
+    }
+
+    p->pos = pos;
+    p->state = state;
+
+    if (state == ST_DONE) return HTTP_PARSE_DONE;
+    if (state == ST_ERROR) return HTTP_PARSE_ERROR;
+    return HTTP_PARSE_AGAIN;
+}
+
+
+int http_parser_has_body(const http_parser_t* p, const char* buf) {
+    if (p->headers[HTTP_HDR_TRANSFER_ENCODING].len > 0) return 1;
+
+    size_t len = 0;
+    const char* v = http_parser_header(p, buf, HTTP_HDR_CONTENT_LENGTH, &len);
+    if (!v) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (v[i] != '0') return 1;      // outro dígito (corpo) ou lixo (inválido)
+    }
+    return 0;
+}
+
+
+const char* http_parser_header(const http_parser_t* p, const char* buf,
+                               http_header_id_t id, size_t* len_out) {
+    if ((int)id < 0 || id >= HTTP_HDR_COUNT || p->headers[id].len == 0) {
+        if (len_out) *len_out = 0;
+        return NULL;
+    }
+    if (len_out) *len_out = p->headers[id].len;
+    return buf + p->headers[id].off;
+}
+
+
+int http_slice_equals_ci(const char* buf, http_slice_t s, const char* str) {
+    size_t n = strlen(str);
+    if (s.len != n) return 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (lower_ascii((unsigned char)buf[s.off + i]) != lower_ascii((unsigned char)str[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+int http_header_has_token(const http_parser_t* p, const char* buf,
+                          http_header_id_t id, const char* token) {
+    size_t len = 0;
+    const char* v = http_parser_header(p, buf, id, &len);
+    if (!v) return 0;
+
+    // Percorrer a lista separada por vírgulas, sem espaços à volta de cada item
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && (v[i] == ' ' || v[i] == '\t' || v[i] == ',')) i++;
+        size_t start = i;
+        while (i < len && v[i] != ',') i++;
+        size_t end = i;
+        while (end > start && (v[end - 1] == ' ' || v[end - 1] == '\t')) end--;
+
+        http_slice_t item = { (uint32_t)(v + start - buf), (uint32_t)(end - start) };
+        if (end > start && http_slice_equals_ci(buf, item, token)) {
+            return 1;
+        }
+    }
+    return 0;
+}
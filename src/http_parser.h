@@ -0,0 +1,121 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Parser incremental de pedidos HTTP/1.x (request line + headers).
+ *
+ * Máquina de estados que percorre cada byte uma única vez: quando chegam mais
+ * dados (recv), http_parser_execute() continua exatamente onde tinha parado,
+ * sem voltar a varrer o que já foi visto. O resultado não copia nada: guarda
+ * fatias (offset/length) do buffer da ligação para a request line e para uma
+ * tabela de headers conhecidos (Connection, Range, Host, ...).
+ */
+
+/* Métodos reconhecidos (o resto fica HTTP_METHOD_OTHER) */
+typedef enum {
+    HTTP_METHOD_OTHER = 0,
+    HTTP_METHOD_GET,
+    HTTP_METHOD_HEAD,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_OPTIONS
+} http_method_t;
+
+/* Headers guardados na tabela (os restantes são validados e ignorados) */
+typedef enum {
+    HTTP_HDR_HOST = 0,
+    HTTP_HDR_CONNECTION,
+    HTTP_HDR_RANGE,
+    HTTP_HDR_IF_NONE_MATCH,
+    HTTP_HDR_IF_MODIFIED_SINCE,
+    HTTP_HDR_ACCEPT_ENCODING,
+    HTTP_HDR_USER_AGENT,
+    HTTP_HDR_CONTENT_LENGTH,
+    HTTP_HDR_TRANSFER_ENCODING,
+    HTTP_HDR_COUNT
+} http_header_id_t;
+
+/* Fatia do buffer: buf[off .. off+len[ (len == 0 => ausente) */
+typedef struct {
+    uint32_t off;
+    uint32_t len;
+} http_slice_t;
+
+typedef enum {
+    HTTP_PARSE_DONE = 0,   // headers completos (header_len bytes)
+    HTTP_PARSE_AGAIN,      // faltam dados
+    HTTP_PARSE_ERROR       // pedido mal formado (responder 400)
+} http_parse_result_t;
+
+typedef struct {
+    /* estado interno (retoma) */
+    int      state;
+    uint32_t pos;           // próximo byte a analisar
+    uint32_t mark;          // início do token atual
+    int      cur_header;    // header a ser lido (http_header_id_t ou -1)
+
+    /* resultado */
+    http_method_t method;
+    http_slice_t  method_str;
+    http_slice_t  path;
+    http_slice_t  version;
+    int           version_minor;               // 0 => HTTP/1.0, 1 => HTTP/1.1
+    http_slice_t  headers[HTTP_HDR_COUNT];
+    uint32_t      header_len;                  // tamanho do pedido (até ao fim da linha vazia)
+} http_parser_t;
+
+
+/**
+ * Prepara o parser para um novo pedido no início do buffer.
+ */
+void http_parser_reset(http_parser_t* p);
+
+
+/**
+ * Continua a análise de buf[0..len[ a partir de onde ficou na chamada anterior.
+ * buf tem de conter os mesmos bytes iniciais entre chamadas (só pode crescer).
+ *
+ * Retorna HTTP_PARSE_DONE, HTTP_PARSE_AGAIN ou HTTP_PARSE_ERROR. Depois de DONE
+ * ou ERROR, chamadas seguintes devolvem o mesmo resultado até http_parser_reset().
+ * Content-Length / Transfer-Encoding vazios ou repetidos são um ERROR (o
+ * tamanho do pedido tem de ser inequívoco).
+ */
+http_parse_result_t http_parser_execute(http_parser_t* p, const char* buf, size_t len);
+
+
+/**
+ * 1 se o pedido (já DONE) declara um corpo: Transfer-Encoding, ou Content-Length
+ * diferente de 0 ou inválido. O servidor não lê corpos, por isso estes pedidos
+ * levam 400 e a ligação é fechada: o corpo nunca é analisado como o pedido
+ * seguinte (request smuggling atrás de um proxy).
+ */
+int http_parser_has_body(const http_parser_t* p, const char* buf);
+
+
+/**
+ * Valor do header id (ou NULL se ausente); *len_out recebe o comprimento.
+ */
+const char* http_parser_header(const http_parser_t* p, const char* buf,
+                               http_header_id_t id, size_t* len_out);
+
+
+/**
+ * Compara uma fatia com uma string, sem distinguir maiúsculas/minúsculas.
+ * Retorna 1 se forem iguais.
+ */
+int http_slice_equals_ci(const char* buf, http_slice_t s, const char* str);
+
+
+/**
+ * Verifica se um header de lista (ex: "Connection: keep-alive, Upgrade")
+ * contém o token dado (case-insensitive). Retorna 1 se contém.
+ */
+int http_header_has_token(const http_parser_t* p, const char* buf,
+                          http_header_id_t id, const char* token);
+
+
+#endif /* HTTP_PARSER_H */
@@ -12,6 +12,7 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 
 #include "master.h"
@@ -21,6 +22,7 @@
 #include "worker.h"
 #include "stats.h"
 #include "cache.h"
+#include "mime.h"
 #include "logger.h"
 
 typedef struct {
@@ -38,7 +40,7 @@ static void print_usage(const char* progname) {
         "Options:\n"
         "  -c, --config PATH   Configuration file path (default: ./server.conf)\n"
         "  -p, --port PORT     Port to listen on (default: 8080 or config file)\n"
-        "  -w, --workers NUM   Number of worker threads/processes (override config)\n"
+        "  -w, --workers NUM   Number of worker processes (override config)\n"
         "  -t, --threads NUM   Threads per worker (override config)\n"
         "  -d, --daemon        Run in background\n"
         "  -v, --verbose       Enable verbose logging\n"
@@ -126,6 +128,66 @@ static void parse_cmdline(int argc, char* argv[], cmdline_opts_t* opts) {
     }
 }
 
+#define RESPAWN_BACKOFF_MAX 30   // segundos máximos entre tentativas de recriar um worker
+#define RESPAWN_STABLE_SECS 10   // um worker que durou isto volta a ser recriado logo
+
+/* Estado do master para cada posição de worker */
+typedef struct {
+    pid_t  pid;          // 0 => nenhum processo (à espera de ser recriado)
+    int    ready_fd;     // ponta de leitura do pipe de arranque (-1 => fechada)
+    int    ever_ready;   // 1 se algum worker nesta posição chegou a aceitar ligações
+    time_t started;      // quando o processo atual foi criado
+    int    backoff;      // atraso (s) antes da próxima recriação
+    time_t respawn_at;   // quando recriar (com pid == 0)
+} worker_slot_t;
+
+/*
+ * Cria um worker process. O filho corre worker_process_main() e nunca
+ * regressa ao código do master; avisa pelo pipe de slot->ready_fd quando já
+ * está a aceitar ligações.
+ * Retorna o PID do filho, ou -1 se pipe() / fork() falhar.
+ */
+static pid_t spawn_worker(int worker_id, worker_slot_t* slot, shared_data_t* shared,
+                          semaphores_t* sems, server_config_t* config) {
+    int fds[2];
+    if (pipe(fds) < 0) return -1;
+
+    fflush(stdout);   // não duplicar output pendente no filho
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        exit(worker_process_main(worker_id, shared, sems, config, fds[1]));
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    slot->pid = pid;
+    slot->ready_fd = fds[0];
+    slot->started = time(NULL);
+    return pid;
+}
+
+/* 1 se o worker que acabou de terminar chegou a avisar que estava pronto */
+static int worker_was_ready(worker_slot_t* slot) {
+    char c;
+    int ready = (slot->ready_fd >= 0 && read(slot->ready_fd, &c, 1) == 1);
+    if (slot->ready_fd >= 0) close(slot->ready_fd);
+    slot->ready_fd = -1;
+    return ready;
+}
+
+static int find_worker(const worker_slot_t* workers, int num_workers, pid_t pid) {
+    for (int i = 0; i < num_workers; ++i) {
+        if (workers[i].pid == pid) return i;
+    }
+    return -1;
+}
+
 int main(int argc, char* argv[]) {
     cmdline_opts_t opts;
     parse_cmdline(argc, argv, &opts);
@@ -177,131 +239,89 @@ int main(int argc, char* argv[]) {
         freopen("/dev/null", "w", stderr);
     }
 
-    // Instalar handler para Ctrl+C
+    // Instalar handler para Ctrl+C (SIGINT) e kill (SIGTERM)
     struct sigaction sa;
     sa.sa_handler = signal_handler;
     sigemptyset(&sa.sa_mask);
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
     // Ignorar SIGPIPE para evitar terminar processo ao escrever em sockets fechados
     signal(SIGPIPE, SIG_IGN);
 
-    // Criar memória partilhada
+    // Verificar que a porta está livre com um socket sem SO_REUSEPORT: caso
+    // contrário uma segunda instância do servidor partilharia a porta em silêncio
+    int probe_fd = create_server_socket(config.port, 0);
+    if (probe_fd < 0) {
+        perror("create_server_socket");
+        return EXIT_FAILURE;
+    }
+    close(probe_fd);
+
+    // Criar memória partilhada (estatísticas globais de todos os processos)
     shared_data_t* shared = create_shared_memory();
     if (!shared) {
         perror("create_shared_memory");
         return EXIT_FAILURE;
     }
 
-    // Definir tamanho lógico da queue (respeitando MAX_QUEUE_SIZE)
-    int queue_size = config.max_queue_size;
-    if (queue_size <= 0 || queue_size > MAX_QUEUE_SIZE) {
-        queue_size = MAX_QUEUE_SIZE;
-    }
-    shared->queue.capacity = queue_size;
-
-    // Inicializar semáforos
+    // Inicializar semáforos partilhados (stats + log)
     semaphores_t sems;
-    if (init_semaphores(&sems, queue_size) < 0) {
+    if (init_semaphores(&sems) < 0) {
         perror("init_semaphores");
         destroy_shared_memory(shared);
         return EXIT_FAILURE;
     }
 
-    // Inicializar cache de ficheiros com tamanho da config (MB -> bytes)
-    long cache_bytes = (config.cache_size_mb > 0) ? (long)config.cache_size_mb * 1024L * 1024L
-                                                  : CACHE_DEFAULT_MAX_BYTES;
-    if (cache_init(cache_bytes) < 0) {
-        fprintf(stderr, "Erro a inicializar cache de ficheiros\n");
-        destroy_semaphores(&sems);
-        destroy_shared_memory(shared);
-        return EXIT_FAILURE;
-    }
+    // Criar os worker processes (prefork): cada um tem socket, fila, cache e threads próprios
+    int num_workers = (config.num_workers > 0) ? config.num_workers : 1;
 
-    // Inicializar sistema de logging
-    if (logger_init(config.log_file, &sems) < 0) {
-        fprintf(stderr, "Erro a inicializar logger\n");
-        destroy_semaphores(&sems);
-        destroy_shared_memory(shared);
-        cache_destroy();
-        return EXIT_FAILURE;
+    // Cache partilhado (opcional): criado antes do fork para ser herdado por todos os
+    // workers, incluindo os que forem recriados; senão cada processo tem o seu
+    if (config.cache_shared) {
+        long cache_bytes = (config.cache_size_mb > 0) ? (long)config.cache_size_mb * 1024L * 1024L
+                                                      : CACHE_DEFAULT_MAX_BYTES;
+        if (cache_shared_create(cache_bytes, config.cache_shards, num_workers) < 0) {
+            fprintf(stderr, "Master: cache partilhado indisponível, a usar um cache por processo\n");
+        }
     }
 
-    // Criar pool de worker threads (consumidores)
-    int total_threads = config.num_workers * config.threads_per_worker;
-    if (total_threads <= 0) total_threads = 1; // fallback seguro
+    // Tipos MIME extra: lidos antes do fork, para os ids serem iguais em todos os workers
+    if (config.mime_types_file[0] && mime_load_file(config.mime_types_file) < 0) {
+        fprintf(stderr, "Master: não foi possível ler MIME_TYPES_FILE '%s', só os tipos embutidos\n",
+                config.mime_types_file);
+    }
 
-    pthread_t* threads = calloc(total_threads, sizeof(pthread_t));
-    if (!threads) {
-        perror("calloc threads");
-        logger_shutdown();
-        cache_destroy();
+    worker_slot_t* workers = calloc(num_workers, sizeof(worker_slot_t));
+    if (!workers) {
+        perror("calloc workers");
         destroy_semaphores(&sems);
         destroy_shared_memory(shared);
         return EXIT_FAILURE;
     }
 
-    worker_args_t wargs = {
-        .shared = shared,
-        .sems = &sems,
-        .config = &config
-    };
-
-    int threads_created = 0;
-    for (int i = 0; i < total_threads; ++i) {
-        if (pthread_create(&threads[i], NULL, worker_thread_main, &wargs) != 0) {
-            perror("pthread_create");
-            threads_created = i;
+    int exit_code = EXIT_SUCCESS;
+    for (int i = 0; i < num_workers; ++i) {
+        workers[i].ready_fd = -1;
+    }
+    for (int i = 0; i < num_workers; ++i) {
+        if (spawn_worker(i, &workers[i], shared, &sems, &config) < 0) {
+            perror("fork");
             keep_running = 0;
+            exit_code = EXIT_FAILURE;
             break;
         }
-        threads_created++;
-    }
-
-    if (threads_created != total_threads) {
-        fprintf(stderr, "Erro a criar pool de workers\n");
-        keep_running = 0;
-        for (int i = 0; i < threads_created; ++i) {
-            pthread_join(threads[i], NULL);
-        }
-        free(threads);
-        logger_shutdown();
-        cache_destroy();
-        destroy_semaphores(&sems);
-        destroy_shared_memory(shared);
-        return EXIT_FAILURE;
-    }
-
-    // Criar socket de escuta
-    int listen_fd = create_server_socket(config.port);
-    if (listen_fd < 0) {
-        perror("create_server_socket");
-        keep_running = 0;
-        for (int i = 0; i < threads_created; ++i) {
-            pthread_join(threads[i], NULL);
-        }
-        free(threads);
-        logger_shutdown();
-        cache_destroy();
-        destroy_semaphores(&sems);
-        destroy_shared_memory(shared);
-        return EXIT_FAILURE;
     }
 
-    // Timeout configurável para accept() (TIMEOUT_SECONDS) para evitar bloqueio indefinido
-    struct timeval tv;
-    tv.tv_sec = (config.timeout_seconds > 0) ? config.timeout_seconds : 1;
-    tv.tv_usec = 0;
-    if (setsockopt(listen_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        perror("setsockopt(SO_RCVTIMEO)");
+    if (keep_running) {
+        printf("Master (PID %d): %d worker processes na porta %d\n",
+               (int)getpid(), num_workers, config.port);
+        fflush(stdout);
     }
 
-    printf("Master: a ouvir na porta %d (queue size = %d)\n",
-           config.port, queue_size);
-    
     time_t start_time = time(NULL);
     time_t last_time_print = start_time;
-    //   LOOP PRINCIPAL (master)
+    //   LOOP PRINCIPAL (master): supervisiona os workers e imprime estatísticas
     while (keep_running) {
         // A cada 30s imprime estatísticas
         if (time(NULL) - last_time_print >= 30) {
@@ -309,54 +329,78 @@ int main(int argc, char* argv[]) {
             last_time_print = time(NULL);
         }
 
-        int client_fd = accept(listen_fd, NULL, NULL);
-        if (client_fd < 0) {
-            if (errno == EINTR) {
-                // interrompido por sinal -> termina se já estamos a encerrar
-                if (!keep_running) break;
-                continue;
+        // Recolher workers que terminaram
+        int status;
+        pid_t pid;
+        time_t now = time(NULL);
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            int idx = find_worker(workers, num_workers, pid);
+            if (idx < 0) continue;
+            worker_slot_t* slot = &workers[idx];
+            slot->pid = 0;
+            int was_ready = worker_was_ready(slot);
+            slot->ever_ready |= was_ready;
+
+            if (!slot->ever_ready && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE) {
+                // Erro no primeiro arranque (ex: porta ocupada): não adianta tentar de novo
+                fprintf(stderr, "Master: worker %d falhou no arranque, a terminar\n", idx);
+                keep_running = 0;
+                exit_code = EXIT_FAILURE;
+                break;
             }
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // timeout do accept -> permite cair no print de 30s
-                continue;
+
+            // Falhas seguidas (no arranque ou pouco depois) esperam cada vez mais
+            if (was_ready && now - slot->started >= RESPAWN_STABLE_SECS) {
+                slot->backoff = 0;
+            } else {
+                slot->backoff = slot->backoff ? slot->backoff * 2 : 1;
+                if (slot->backoff > RESPAWN_BACKOFF_MAX) slot->backoff = RESPAWN_BACKOFF_MAX;
+            }
+            slot->respawn_at = now + slot->backoff;
+            if (keep_running) {
+                fprintf(stderr, "Master: worker %d (PID %d) terminou inesperadamente, a reiniciar em %ds\n",
+                        idx, (int)pid, slot->backoff);
             }
-            perror("accept");
-            break;
         }
 
-        // Tenta enfileirar na queue partilhada
-        if (enqueue_connection(shared, &sems, client_fd) < 0) {
-            // Já foi enviada resposta 503 + close() dentro de enqueue_connection
-            continue;
+        // Recriar os que já esperaram o suficiente
+        for (int i = 0; i < num_workers && keep_running; ++i) {
+            if (workers[i].pid != 0 || now < workers[i].respawn_at) continue;
+            if (spawn_worker(i, &workers[i], shared, &sems, &config) < 0) {
+                perror("fork");
+                workers[i].backoff = workers[i].backoff ? workers[i].backoff * 2 : 1;
+                if (workers[i].backoff > RESPAWN_BACKOFF_MAX) workers[i].backoff = RESPAWN_BACKOFF_MAX;
+                workers[i].respawn_at = now + workers[i].backoff;
+            }
         }
 
-        // Se chegámos aqui, uma worker thread nalgum worker process
-        // irá fazer dequeue_connection() e tratar o pedido HTTP.
+        sleep(1);   // interrompido por SIGINT/SIGTERM
     }
 
     printf("Master: a terminar e limpar recursos..\n");
     keep_running = 0;
 
-    // Desbloquear threads que possam estar em sem_wait(filled_slots)
-    for (int i = 0; i < threads_created; ++i) {
-        sem_post(sems.filled_slots);
+    // Pedir aos workers para terminarem e esperar por eles
+    for (int i = 0; i < num_workers; ++i) {
+        if (workers[i].pid > 0) {
+            kill(workers[i].pid, SIGTERM);
+        }
     }
-    for (int i = 0; i < threads_created; ++i) {
-        pthread_join(threads[i], NULL);
+    for (int i = 0; i < num_workers; ++i) {
+        if (workers[i].pid > 0) {
+            waitpid(workers[i].pid, NULL, 0);
+        }
+        if (workers[i].ready_fd >= 0) close(workers[i].ready_fd);
     }
-    free(threads);
+    free(workers);
 
     // Mostrar estatísticas finais
     stats_print(shared, &sems, difftime(time(NULL), start_time));
-    
-    // Fechar sistema de logging (flush + close do ficheiro)
-    logger_shutdown();
 
     // Limpeza
-    close(listen_fd);
+    cache_shared_destroy();
     destroy_semaphores(&sems);
     destroy_shared_memory(shared);
-    cache_destroy();
 
-    return EXIT_SUCCESS;
+    return exit_code;
 }
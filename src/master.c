@@ -1,3 +1,5 @@
+#define _GNU_SOURCE  // expõe SO_REUSEPORT
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -10,7 +12,7 @@
 #include <time.h>
 
 #include "master.h"
-#include "http.h"      // para send_http_response()
+#include "http.h"      // para http_error_response()
 #include "shared_mem.h"
 #include "semaphores.h"
 #include "config.h"
@@ -26,18 +28,21 @@ void signal_handler(int signum) {
     keep_running = 0;
 }
 
-static void send_503_response(int client_fd, shared_data_t* data, semaphores_t* sems);
 
 /*
  * Cria o socket de escuta na porta dada.
  * Retorna fd >= 0 em sucesso, -1 em erro.
  */
-int create_server_socket(int port) {
+int create_server_socket(int port, int reuse_port) {
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) return -1;
 
     int opt = 1;
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        close(sockfd);
+        return -1;
+    }
 
     struct sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -49,7 +54,9 @@ int create_server_socket(int port) {
         return -1;
     }
 
-    if (listen(sockfd, 128) < 0) {
+    // Backlog grande: o event loop aceita rapidamente, mas picos de ligações novas
+    // não devem ser recusados pelo kernel
+    if (listen(sockfd, SOMAXCONN) < 0) {
         close(sockfd);
         return -1;
     }
@@ -60,27 +67,22 @@ int create_server_socket(int port) {
 
 /*
  * Envia uma resposta HTTP 503 simples e não bloqueante.
+ * Corre no thread do event loop: um só send() com MSG_DONTWAIT. A resposta
+ * cabe no buffer de um socket acabado de aceitar; se mesmo assim não couber
+ * (EAGAIN ou envio parcial) é descartada, e o chamador fecha a ligação.
  */
-static void send_503_response(int client_fd, shared_data_t* data, semaphores_t* sems) {
-    const char* body =
-        "<html><body><h1>503 Service Unavailable</h1>"
-        "<p>Server queue is full, please try again later.</p>"
-        "</body></html>";
-
-    size_t body_len = strlen(body);
-
-    send_http_response(
-        client_fd,
-        503, "Service Unavailable",
-        "text/html",
-        body,
-        body_len,
-        0
-    );
-
-    // Registar bytes transferidos para este 503 (contamos só o body)
+void send_503_response(int client_fd, shared_data_t* data, semaphores_t* sems, int shed) {
+    // Resposta fixa, formatada uma só vez
+    const http_blob_t* blob = http_error_response(HTTP_ERR_503);
+    ssize_t n;
+    do {
+        n = send(client_fd, blob->data, blob->len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    size_t body_len = (n == (ssize_t)blob->len) ? blob->body_len : 0;
+
+    // Registar bytes transferidos para este 503 (contamos só o body; 0 se foi descartada)
     if (data && sems) {
-        stats_record_503(data, sems, body_len);
+        stats_record_503(data, sems, body_len, shed);
     }
 
     // Log request com placeholders (sem método/path reais)
@@ -89,51 +91,16 @@ static void send_503_response(int client_fd, shared_data_t* data, semaphores_t*
 
 
 /*
- * Produtor: tenta colocar um client_fd na fila.
- * Usa semáforos (empty_slots, filled_slots, queue_mutex) como bounded buffer.
+ * Produtor: tenta colocar um client_fd na fila do worker process.
+ * A fila é lock-free: no caso normal não há syscalls nem locks.
  * Retorna 0 em sucesso, -1 se falhar (já trata do socket).
  */
-int enqueue_connection(shared_data_t* data, semaphores_t* sems, int client_fd) {
-    // Tentar reservar slot livre sem bloquear indefinidamente
-    if (sem_trywait(sems->empty_slots) == -1) {
-        if (errno == EAGAIN) {
-            send_503_response(client_fd, data, sems);
-            close(client_fd);
-            return -1;
-        } else {
-            perror("sem_trywait(empty_slots)");
-            send_503_response(client_fd, data, sems);
-            close(client_fd);
-            return -1;
-        }
-    }
-
-    if (sem_wait(sems->queue_mutex) == -1) {
-        perror("sem_wait(queue_mutex)");
-        sem_post(sems->empty_slots); // devolve slot
-        send_503_response(client_fd, data, sems);
+int enqueue_connection(connection_queue_t* queue, shared_data_t* data, semaphores_t* sems, int client_fd) {
+    // Fila cheia -> 503 imediato (não bloqueamos o event loop)
+    if (conn_queue_try_push(queue, client_fd) < 0) {
+        send_503_response(client_fd, data, sems, 0);
         close(client_fd);
         return -1;
     }
-
-    int capacity = data->queue.capacity > 0 && data->queue.capacity <= MAX_QUEUE_SIZE
-                 ? data->queue.capacity
-                 : MAX_QUEUE_SIZE;
-
-    if (data->queue.count >= capacity) {
-        // Defesa adicional
-        sem_post(sems->queue_mutex);
-        sem_post(sems->empty_slots);
-        send_503_response(client_fd, data, sems);
-        close(client_fd);
-        return -1;
-    }
-
-    data->queue.sockets[data->queue.rear] = client_fd;
-    data->queue.rear = (data->queue.rear + 1) % MAX_QUEUE_SIZE;
-    data->queue.count++;
-
-    sem_post(sems->queue_mutex);
-    sem_post(sems->filled_slots);
     return 0;
 }
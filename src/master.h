@@ -4,6 +4,7 @@
 #include <signal.h>
 #include "shared_mem.h"
 #include "semaphores.h"
+#include "conn_queue.h"
 #include "stats.h"
 
 /**
@@ -21,18 +22,29 @@ void signal_handler(int signum);
 
 /**
  * Cria o socket de escuta na porta dada.
+ * Com reuse_port != 0 usa SO_REUSEPORT: cada worker process cria o seu próprio
+ * socket na mesma porta e o kernel distribui as novas ligações entre eles.
  * Retorna:
  *   >= 0  fd do socket de escuta
  *   -1    em caso de erro
  */
-int create_server_socket(int port);
+int create_server_socket(int port, int reuse_port);
+
+/**
+ * Envia uma resposta 503 Service Unavailable (não fecha o socket). Nunca
+ * bloqueia: se o socket não aceitar a resposta de uma vez, é descartada.
+ * Usada quando a fila está cheia e pelo CoDel (shed != 0) quando uma ligação
+ * esperou demasiado tempo na fila.
+ */
+void send_503_response(int client_fd, shared_data_t* data, semaphores_t* sems, int shed);
 
 /**
  * Produtor: tenta enfileirar uma nova conexão na
- * fila partilhada (bounded buffer).
+ * fila do worker process (bounded buffer).
  *
  * Parâmetros:
- *   data  - apontador para a memória partilhada (shared_data_t)
+ *   queue - fila de ligações deste worker process
+ *   data  - apontador para a memória partilhada (shared_data_t, para stats)
  *   sems  - conjunto de semáforos (semaphores_t)
  *   client_fd - socket da conexão aceite por accept()
  *
@@ -40,6 +52,6 @@ int create_server_socket(int port);
  *   0  em sucesso (socket ficou na fila para um worker tratar)
  *  -1  em erro ou fila cheia (neste caso, a função já envia 503 e fecha o socket)
  */
-int enqueue_connection(shared_data_t* data, semaphores_t* sems, int client_fd);
+int enqueue_connection(connection_queue_t* queue, shared_data_t* data, semaphores_t* sems, int client_fd);
 
 #endif /* MASTER_H */
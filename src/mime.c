@@ -0,0 +1,183 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mime.h"
+#include "mime_table.h"
+
+/*
+ * Ids: 0 = MIME_DEFAULT; 1..MIME_TABLE_SIZE = slot + 1 da tabela gerada;
+ * acima disso, slot + 1 da tabela de MIME_TYPES_FILE. A tabela do ficheiro
+ * é preenchida antes do fork e não muda depois, por isso não tem lock e os
+ * ids são os mesmos em todos os processos.
+ */
+typedef struct {
+    char* ext;                  // NULL = slot livre
+    char* type;
+} mime_custom_t;
+
+static mime_custom_t* g_custom = NULL;
+static size_t         g_custom_size = 0;    // potência de 2
+static size_t         g_custom_count = 0;
+
+
+static int custom_grow(void) {
+    size_t size = g_custom_size ? g_custom_size * 2 : 64;
+    mime_custom_t* table = calloc(size, sizeof(*table));
+    if (!table) return -1;
+
+    for (size_t i = 0; i < g_custom_size; ++i) {
+        if (!g_custom[i].ext) continue;
+        size_t slot = mime_hash(g_custom[i].ext, strlen(g_custom[i].ext), 0) & (size - 1);
+        while (table[slot].ext) {
+            slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = g_custom[i];
+    }
+    free(g_custom);
+    g_custom = table;
+    g_custom_size = size;
+    return 0;
+}
+
+
+/* Slot de ext (len < MIME_EXT_MAX, minúsculas) na tabela do ficheiro: a entrada, ou o livre onde iria */
+static size_t custom_find(const char* ext, size_t len) {
+    size_t slot = mime_hash(ext, len, 0) & (g_custom_size - 1);
+    while (g_custom[slot].ext &&
+           !(strncmp(g_custom[slot].ext, ext, len) == 0 && g_custom[slot].ext[len] == '\0')) {
+        slot = (slot + 1) & (g_custom_size - 1);
+    }
+    return slot;
+}
+
+
+static int custom_add(const char* ext, const char* type) {
+    size_t len = strlen(ext);
+    if (len == 0 || len >= MIME_EXT_MAX) return 0;
+
+    char lower[MIME_EXT_MAX];
+    for (size_t i = 0; i <= len; ++i) {
+        lower[i] = (char)((ext[i] >= 'A' && ext[i] <= 'Z') ? ext[i] - 'A' + 'a' : ext[i]);
+    }
+
+    // ocupação máxima de 1/2
+    if (2 * (g_custom_count + 1) > g_custom_size && custom_grow() < 0) return -1;
+
+    size_t slot = custom_find(lower, len);
+    char* t = strdup(type);
+    if (!t) return -1;
+    if (g_custom[slot].ext) {
+        free(g_custom[slot].type);      // repetida: fica a última
+    } else {
+        g_custom[slot].ext = strdup(lower);
+        if (!g_custom[slot].ext) {
+            free(t);
+            return -1;
+        }
+        g_custom_count++;
+    }
+    g_custom[slot].type = t;
+    return 1;
+}
+
+
+int mime_load_file(const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        perror("mime_load_file");
+        return -1;
+    }
+
+    int loaded = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char* save = NULL;
+        const char* type = strtok_r(line, " \t\r\n;", &save);
+        // "types {" e "}" do formato do nginx
+        if (!type || strcmp(type, "types") == 0 || strcmp(type, "{") == 0 || strcmp(type, "}") == 0) {
+            continue;
+        }
+        if (!strchr(type, '/')) continue;
+
+        const char* ext;
+        while ((ext = strtok_r(NULL, " \t\r\n;", &save)) != NULL) {
+            int r = custom_add(ext, type);
+            if (r < 0) {
+                perror("mime_load_file");
+                fclose(fp);
+                return -1;
+            }
+            loaded += r;
+        }
+    }
+    fclose(fp);
+    return loaded;
+}
+
+
+int mime_lookup(const char* path) {
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char* dot = strrchr(base, '.');
+    if (!dot || dot == base) return 0;         // sem extensão, ou ficheiro escondido (".htaccess")
+
+    char ext[MIME_EXT_MAX];
+    size_t len = 0;
+    for (const char* p = dot + 1; *p; ++p) {
+        if (len == MIME_EXT_MAX - 1) return 0;
+        ext[len++] = (char)((*p >= 'A' && *p <= 'Z') ? *p - 'A' + 'a' : *p);
+    }
+    if (len == 0) return 0;
+    ext[len] = '\0';
+
+    if (g_custom_count > 0) {
+        size_t slot = custom_find(ext, len);
+        if (g_custom[slot].ext) return (int)(MIME_TABLE_SIZE + 1 + slot);
+    }
+
+    uint32_t slot = mime_hash(ext, len, MIME_TABLE_SEED) & (MIME_TABLE_SIZE - 1);
+    if (g_mime_table[slot].ext && strcmp(g_mime_table[slot].ext, ext) == 0) {
+        return (int)slot + 1;
+    }
+    return 0;
+}
+
+
+const char* mime_name(int id) {
+    if (id <= 0) return MIME_DEFAULT;
+    if ((size_t)id <= MIME_TABLE_SIZE) {
+        const char* type = g_mime_table[id - 1].type;
+        return type ? type : MIME_DEFAULT;
+    }
+    size_t slot = (size_t)id - MIME_TABLE_SIZE - 1;
+    if (slot < g_custom_size && g_custom[slot].type) return g_custom[slot].type;
+    return MIME_DEFAULT;
+}
+
+
+int mime_compressible(const char* type) {
+    if (strncmp(type, "text/", 5) == 0) return 1;
+
+    static const char* const suffixes[] = { "+xml", "+json", "/xml", "/json" };
+    size_t len = strlen(type);
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+        size_t n = strlen(suffixes[i]);
+        if (len > n && strcmp(type + len - n, suffixes[i]) == 0) return 1;
+    }
+
+    static const char* const types[] = {
+        "application/javascript", "application/wasm", "application/rtf",
+        "application/vnd.ms-fontobject", "font/ttf", "font/otf", "image/bmp",
+        "image/x-icon",
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strcmp(type, types[i]) == 0) return 1;
+    }
+    return 0;
+}
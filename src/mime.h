@@ -0,0 +1,73 @@
+#ifndef MIME_H
+#define MIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIME_DEFAULT  "application/octet-stream"
+#define MIME_EXT_MAX  16        // extensões maiores não têm tipo (ficam com MIME_DEFAULT)
+
+/**
+ * Tipos MIME por extensão.
+ *
+ * Os tipos conhecidos estão numa tabela com hash perfeito gerada por
+ * src/mime_gen.c (make mime-table -> src/mime_table.h): cada extensão cai
+ * num slot só seu, por isso uma procura é um hash e uma comparação.
+ * MIME_TYPES_FILE (opcional) acrescenta ou substitui tipos.
+ *
+ * O tipo é resolvido uma vez, quando o ficheiro entra no cache, e guardado
+ * com a entrada: o caminho dos hits nunca compara strings para isto.
+ */
+
+
+/**
+ * Hash de uma extensão (já em minúsculas), partilhado pelo gerador e pela
+ * procura: FNV-1a de 32 bits com seed, seguido de uma mistura final.
+ */
+static inline uint32_t mime_hash(const char* ext, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)ext[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+
+/**
+ * Lê um ficheiro de tipos no formato do mime.types (nginx/Apache): uma linha
+ * por tipo, "tipo ext1 ext2 ...", com "#" para comentários; o "types {" / "}"
+ * e os ";" do nginx são ignorados. Estes tipos têm prioridade sobre os
+ * embutidos. Chamar no master, antes do fork (os ids têm de ser iguais em
+ * todos os worker processes por causa do cache partilhado).
+ *
+ * Retorna o nº de extensões lidas, ou -1 em erro.
+ */
+int mime_load_file(const char* filename);
+
+
+/**
+ * Id do tipo MIME de path, pela extensão do último componente
+ * (0 = desconhecido, MIME_DEFAULT). Não distingue maiúsculas.
+ */
+int mime_lookup(const char* path);
+
+
+/**
+ * Tipo MIME de um id devolvido por mime_lookup (string estática).
+ */
+const char* mime_name(int id);
+
+
+/**
+ * 1 se vale a pena comprimir um corpo deste tipo (texto, JSON/XML, SVG,
+ * wasm...): os formatos já comprimidos (imagens, áudio, vídeo, arquivos,
+ * woff) ficam de fora.
+ */
+int mime_compressible(const char* type);
+
+
+#endif /* MIME_H */
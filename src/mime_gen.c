@@ -0,0 +1,164 @@
+/*
+ * Gerador da tabela de tipos MIME com hash perfeito (src/mime_table.h).
+ *
+ * Procura a menor tabela (potência de 2) e uma seed para mime_hash() com que
+ * todas as extensões abaixo caem em slots diferentes. Corre em "make
+ * mime-table" sempre que esta lista muda; o resultado fica no repositório.
+ *
+ * Uso: ./src/mime_gen > src/mime_table.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mime.h"
+
+#define MAX_SEEDS (1u << 24)
+
+static const struct {
+    const char* ext;
+    const char* type;
+} g_types[] = {
+    // texto
+    { "html",  "text/html" },
+    { "htm",   "text/html" },
+    { "css",   "text/css" },
+    { "js",    "text/javascript" },
+    { "mjs",   "text/javascript" },
+    { "txt",   "text/plain" },
+    { "csv",   "text/csv" },
+    { "md",    "text/markdown" },
+    { "xml",   "text/xml" },
+    { "ics",   "text/calendar" },
+    { "vcf",   "text/vcard" },
+    // dados / aplicações
+    { "json",  "application/json" },
+    { "map",   "application/json" },
+    { "webmanifest", "application/manifest+json" },
+    { "rss",   "application/rss+xml" },
+    { "atom",  "application/atom+xml" },
+    { "xhtml", "application/xhtml+xml" },
+    { "wasm",  "application/wasm" },
+    { "pdf",   "application/pdf" },
+    { "rtf",   "application/rtf" },
+    { "epub",  "application/epub+zip" },
+    { "zip",   "application/zip" },
+    { "gz",    "application/gzip" },
+    { "tgz",   "application/gzip" },
+    { "tar",   "application/x-tar" },
+    { "bz2",   "application/x-bzip2" },
+    { "xz",    "application/x-xz" },
+    { "7z",    "application/x-7z-compressed" },
+    { "rar",   "application/vnd.rar" },
+    { "jar",   "application/java-archive" },
+    { "apk",   "application/vnd.android.package-archive" },
+    { "deb",   "application/vnd.debian.binary-package" },
+    { "rpm",   "application/x-rpm" },
+    { "iso",   "application/x-iso9660-image" },
+    { "dmg",   "application/x-apple-diskimage" },
+    { "exe",   "application/vnd.microsoft.portable-executable" },
+    { "bin",   "application/octet-stream" },
+    { "doc",   "application/msword" },
+    { "docx",  "application/vnd.openxmlformats-officedocument.wordprocessingml.document" },
+    { "xls",   "application/vnd.ms-excel" },
+    { "xlsx",  "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet" },
+    { "ppt",   "application/vnd.ms-powerpoint" },
+    { "pptx",  "application/vnd.openxmlformats-officedocument.presentationml.presentation" },
+    { "odt",   "application/vnd.oasis.opendocument.text" },
+    { "ods",   "application/vnd.oasis.opendocument.spreadsheet" },
+    // imagens
+    { "png",   "image/png" },
+    { "jpg",   "image/jpeg" },
+    { "jpeg",  "image/jpeg" },
+    { "gif",   "image/gif" },
+    { "svg",   "image/svg+xml" },
+    { "svgz",  "image/svg+xml" },
+    { "webp",  "image/webp" },
+    { "avif",  "image/avif" },
+    { "ico",   "image/x-icon" },
+    { "bmp",   "image/bmp" },
+    { "tif",   "image/tiff" },
+    { "tiff",  "image/tiff" },
+    // fontes
+    { "woff",  "font/woff" },
+    { "woff2", "font/woff2" },
+    { "ttf",   "font/ttf" },
+    { "otf",   "font/otf" },
+    { "eot",   "application/vnd.ms-fontobject" },
+    // áudio / vídeo
+    { "mp3",   "audio/mpeg" },
+    { "ogg",   "audio/ogg" },
+    { "oga",   "audio/ogg" },
+    { "opus",  "audio/opus" },
+    { "wav",   "audio/wav" },
+    { "flac",  "audio/flac" },
+    { "m4a",   "audio/mp4" },
+    { "aac",   "audio/aac" },
+    { "mid",   "audio/midi" },
+    { "mp4",   "video/mp4" },
+    { "m4v",   "video/mp4" },
+    { "webm",  "video/webm" },
+    { "ogv",   "video/ogg" },
+    { "mov",   "video/quicktime" },
+    { "avi",   "video/x-msvideo" },
+    { "mkv",   "video/x-matroska" },
+    { "mpeg",  "video/mpeg" },
+    { "mpg",   "video/mpeg" },
+};
+
+#define NUM_TYPES (sizeof(g_types) / sizeof(g_types[0]))
+
+
+/* 1 se com esta seed nenhuma extensão partilha slot */
+static int try_seed(uint32_t seed, unsigned int size, unsigned char* used) {
+    memset(used, 0, size);
+    for (size_t i = 0; i < NUM_TYPES; ++i) {
+        uint32_t slot = mime_hash(g_types[i].ext, strlen(g_types[i].ext), seed) & (size - 1);
+        if (used[slot]) return 0;
+        used[slot] = 1;
+    }
+    return 1;
+}
+
+
+int main(void) {
+    unsigned int size = 1;
+    while (size < NUM_TYPES) {
+        size <<= 1;
+    }
+
+    for (; size <= 4096; size <<= 1) {
+        unsigned char* used = malloc(size);
+        if (!used) return 1;
+
+        for (uint32_t seed = 1; seed < MAX_SEEDS; ++seed) {
+            if (!try_seed(seed, size, used)) continue;
+
+            printf("/* Gerado por src/mime_gen.c (make mime-table): não editar à mão. */\n");
+            printf("#ifndef MIME_TABLE_H\n#define MIME_TABLE_H\n\n");
+            printf("#define MIME_TABLE_SIZE %uu\n", size);
+            printf("#define MIME_TABLE_SEED 0x%08xu\n\n", seed);
+            printf("/* %zu extensões; slot = mime_hash(ext, seed) & (MIME_TABLE_SIZE - 1) */\n",
+                   NUM_TYPES);
+            printf("static const struct {\n    const char* ext;\n    const char* type;\n}"
+                   " g_mime_table[MIME_TABLE_SIZE] = {\n");
+            for (unsigned int slot = 0; slot < size; ++slot) {
+                for (size_t i = 0; i < NUM_TYPES; ++i) {
+                    const char* ext = g_types[i].ext;
+                    if ((mime_hash(ext, strlen(ext), seed) & (size - 1)) == slot) {
+                        printf("    [%u] = { \"%s\", \"%s\" },\n", slot, ext, g_types[i].type);
+                    }
+                }
+            }
+            printf("};\n\n#endif /* MIME_TABLE_H */\n");
+
+            free(used);
+            fprintf(stderr, "mime_gen: %zu extensões em %u slots (seed %u)\n", NUM_TYPES, size, seed);
+            return 0;
+        }
+        free(used);
+    }
+
+    fprintf(stderr, "mime_gen: nenhuma seed serve\n");
+    return 1;
+}
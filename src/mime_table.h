@@ -0,0 +1,95 @@
+/* Gerado por src/mime_gen.c (make mime-table): não editar à mão. */
+#ifndef MIME_TABLE_H
+#define MIME_TABLE_H
+
+#define MIME_TABLE_SIZE 256u
+#define MIME_TABLE_SEED 0x0002da91u
+
+/* 80 extensões; slot = mime_hash(ext, seed) & (MIME_TABLE_SIZE - 1) */
+static const struct {
+    const char* ext;
+    const char* type;
+} g_mime_table[MIME_TABLE_SIZE] = {
+    [3] = { "apk", "application/vnd.android.package-archive" },
+    [4] = { "bz2", "application/x-bzip2" },
+    [10] = { "bmp", "image/bmp" },
+    [14] = { "docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document" },
+    [19] = { "atom", "application/atom+xml" },
+    [21] = { "mpeg", "video/mpeg" },
+    [27] = { "jpeg", "image/jpeg" },
+    [28] = { "doc", "application/msword" },
+    [39] = { "mkv", "video/x-matroska" },
+    [41] = { "jar", "application/java-archive" },
+    [48] = { "map", "application/json" },
+    [49] = { "csv", "text/csv" },
+    [50] = { "png", "image/png" },
+    [51] = { "tar", "application/x-tar" },
+    [52] = { "rpm", "application/x-rpm" },
+    [56] = { "exe", "application/vnd.microsoft.portable-executable" },
+    [57] = { "gz", "application/gzip" },
+    [68] = { "html", "text/html" },
+    [71] = { "xls", "application/vnd.ms-excel" },
+    [73] = { "m4a", "audio/mp4" },
+    [75] = { "xz", "application/x-xz" },
+    [81] = { "ico", "image/x-icon" },
+    [82] = { "tif", "image/tiff" },
+    [83] = { "avi", "video/x-msvideo" },
+    [85] = { "zip", "application/zip" },
+    [86] = { "htm", "text/html" },
+    [95] = { "odt", "application/vnd.oasis.opendocument.text" },
+    [100] = { "mp4", "video/mp4" },
+    [103] = { "eot", "application/vnd.ms-fontobject" },
+    [105] = { "webm", "video/webm" },
+    [106] = { "xml", "text/xml" },
+    [107] = { "svgz", "image/svg+xml" },
+    [109] = { "mp3", "audio/mpeg" },
+    [114] = { "avif", "image/avif" },
+    [119] = { "tiff", "image/tiff" },
+    [122] = { "webmanifest", "application/manifest+json" },
+    [128] = { "woff2", "font/woff2" },
+    [129] = { "otf", "font/otf" },
+    [132] = { "xhtml", "application/xhtml+xml" },
+    [135] = { "mid", "audio/midi" },
+    [140] = { "tgz", "application/gzip" },
+    [149] = { "gif", "image/gif" },
+    [159] = { "mjs", "text/javascript" },
+    [160] = { "vcf", "text/vcard" },
+    [163] = { "css", "text/css" },
+    [164] = { "ppt", "application/vnd.ms-powerpoint" },
+    [167] = { "json", "application/json" },
+    [169] = { "rtf", "application/rtf" },
+    [171] = { "oga", "audio/ogg" },
+    [173] = { "xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet" },
+    [174] = { "ics", "text/calendar" },
+    [176] = { "bin", "application/octet-stream" },
+    [178] = { "epub", "application/epub+zip" },
+    [183] = { "mpg", "video/mpeg" },
+    [194] = { "rss", "application/rss+xml" },
+    [198] = { "dmg", "application/x-apple-diskimage" },
+    [199] = { "md", "text/markdown" },
+    [200] = { "wav", "audio/wav" },
+    [201] = { "webp", "image/webp" },
+    [202] = { "svg", "image/svg+xml" },
+    [204] = { "deb", "application/vnd.debian.binary-package" },
+    [205] = { "aac", "audio/aac" },
+    [206] = { "js", "text/javascript" },
+    [209] = { "iso", "application/x-iso9660-image" },
+    [210] = { "jpg", "image/jpeg" },
+    [215] = { "woff", "font/woff" },
+    [218] = { "ogv", "video/ogg" },
+    [220] = { "flac", "audio/flac" },
+    [224] = { "ttf", "font/ttf" },
+    [227] = { "opus", "audio/opus" },
+    [230] = { "ods", "application/vnd.oasis.opendocument.spreadsheet" },
+    [233] = { "m4v", "video/mp4" },
+    [238] = { "mov", "video/quicktime" },
+    [239] = { "rar", "application/vnd.rar" },
+    [240] = { "wasm", "application/wasm" },
+    [243] = { "7z", "application/x-7z-compressed" },
+    [246] = { "txt", "text/plain" },
+    [248] = { "pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation" },
+    [249] = { "pdf", "application/pdf" },
+    [255] = { "ogg", "audio/ogg" },
+};
+
+#endif /* MIME_TABLE_H */
@@ -3,15 +3,14 @@
 
 #include <semaphore.h>
 
+/* Semáforos partilhados por todos os processos. A fila de ligações de cada
+   worker process é lock-free (conn_queue.h) e não usa semáforos. */
 typedef struct {
-    sem_t* empty_slots;
-    sem_t* filled_slots;
-    sem_t* queue_mutex;
     sem_t* stats_mutex;
     sem_t* log_mutex;
 } semaphores_t;
 
-int init_semaphores(semaphores_t* sems, int queue_size);
+int init_semaphores(semaphores_t* sems);
 void destroy_semaphores(semaphores_t* sems);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,197 @@
+#include <stdint.h>
+
+#include "simd_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+
+/* ---------- versões escalares (fallback e fim dos buffers) ---------- */
+
+static size_t find_below_scalar(const char* p, size_t n, unsigned char thr) {
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)p[i];
+        if (c <= thr || c == 0x7f) return i;
+    }
+    return n;
+}
+
+static size_t find_ctl_scalar(const char* p, size_t n) {
+    return find_below_scalar(p, n, 0x1f);
+}
+
+static size_t find_ctl_or_space_scalar(const char* p, size_t n) {
+    return find_below_scalar(p, n, 0x20);
+}
+
+/* Para tchars, c | 0x20 só dá uma letra minúscula se c for essa letra (maiúscula ou não) */
+static int equals_lower_scalar(const char* s, const char* lower, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (((unsigned char)s[i] | 0x20) != (unsigned char)lower[i]) return 0;
+    }
+    return 1;
+}
+
+
+#ifdef SIMD_X86
+
+/* ---------- SSE2: 16 bytes por iteração ---------- */
+
+static size_t find_below_sse2(const char* p, size_t n, unsigned char thr) {
+    const __m128i vthr = _mm_set1_epi8((char)thr);
+    const __m128i vdel = _mm_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        // v <= thr (sem sinal)  <=>  min(v, thr) == v
+        __m128i below = _mm_cmpeq_epi8(_mm_min_epu8(v, vthr), v);
+        __m128i hit = _mm_or_si128(below, _mm_cmpeq_epi8(v, vdel));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+    return i + find_below_scalar(p + i, n - i, thr);
+}
+
+static size_t find_ctl_sse2(const char* p, size_t n) {
+    return find_below_sse2(p, n, 0x1f);
+}
+
+static size_t find_ctl_or_space_sse2(const char* p, size_t n) {
+    return find_below_sse2(p, n, 0x20);
+}
+
+static int equals_lower_sse2(const char* s, const char* lower, size_t n) {
+    if (n < 16) return equals_lower_scalar(s, lower, n);
+
+    const __m128i bit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (;; i += 16) {
+        if (i + 16 > n) i = n - 16;   // último bloco sobreposto: sem cauda escalar
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + i)), bit);
+        __m128i b = _mm_loadu_si128((const __m128i*)(lower + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff) return 0;
+        if (i + 16 >= n) return 1;
+    }
+}
+
+
+/* ---------- AVX2: 32 bytes por iteração ---------- */
+
+__attribute__((target("avx2")))
+static size_t find_below_avx2(const char* p, size_t n, unsigned char thr) {
+    const __m256i vthr = _mm256_set1_epi8((char)thr);
+    const __m256i vdel = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i below = _mm256_cmpeq_epi8(_mm256_min_epu8(v, vthr), v);
+        __m256i hit = _mm256_or_si256(below, _mm256_cmpeq_epi8(v, vdel));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + find_below_sse2(p + i, n - i, thr);
+}
+
+__attribute__((target("avx2")))
+static size_t find_ctl_avx2(const char* p, size_t n) {
+    return find_below_avx2(p, n, 0x1f);
+}
+
+__attribute__((target("avx2")))
+static size_t find_ctl_or_space_avx2(const char* p, size_t n) {
+    return find_below_avx2(p, n, 0x20);
+}
+
+#endif /* SIMD_X86 */
+
+
+/* ---------- dispatch ---------- */
+
+typedef size_t (*find_fn_t)(const char*, size_t);
+typedef int (*equals_fn_t)(const char*, const char*, size_t);
+
+static simd_level_t g_best = SIMD_SCALAR;    // melhor nível suportado pelo CPU
+static simd_level_t g_level = SIMD_SCALAR;   // nível em uso
+static find_fn_t    g_find_ctl = find_ctl_scalar;
+static find_fn_t    g_find_ctl_or_space = find_ctl_or_space_scalar;
+static equals_fn_t  g_equals_lower = equals_lower_scalar;
+
+
+static void set_level(simd_level_t level) {
+    g_level = level;
+    switch (level) {
+#ifdef SIMD_X86
+    case SIMD_AVX2:
+        g_find_ctl = find_ctl_avx2;
+        g_find_ctl_or_space = find_ctl_or_space_avx2;
+        g_equals_lower = equals_lower_sse2;   // nomes de headers têm <= 32 bytes
+        break;
+    case SIMD_SSE2:
+        g_find_ctl = find_ctl_sse2;
+        g_find_ctl_or_space = find_ctl_or_space_sse2;
+        g_equals_lower = equals_lower_sse2;
+        break;
+#endif
+    default:
+        g_level = SIMD_SCALAR;
+        g_find_ctl = find_ctl_scalar;
+        g_find_ctl_or_space = find_ctl_or_space_scalar;
+        g_equals_lower = equals_lower_scalar;
+        break;
+    }
+}
+
+
+/* Corre antes de main(): escolhe os kernels pelo CPUID antes de haver threads */
+__attribute__((constructor))
+static void simd_scan_init(void) {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_best = SIMD_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        g_best = SIMD_SSE2;
+    }
+#endif
+    set_level(g_best);
+}
+
+
+simd_level_t simd_scan_level(void) {
+    return g_level;
+}
+
+
+int simd_scan_force(simd_level_t level) {
+    if (level > g_best) return -1;
+    set_level(level);
+    return 0;
+}
+
+
+const char* simd_level_name(simd_level_t level) {
+    switch (level) {
+    case SIMD_AVX2: return "avx2";
+    case SIMD_SSE2: return "sse2";
+    default:        return "scalar";
+    }
+}
+
+
+size_t simd_find_ctl(const char* p, size_t n) {
+    return g_find_ctl(p, n);
+}
+
+
+size_t simd_find_ctl_or_space(const char* p, size_t n) {
+    return g_find_ctl_or_space(p, n);
+}
+
+
+int simd_equals_lower(const char* s, const char* lower, size_t n) {
+    return g_equals_lower(s, lower, n);
+}
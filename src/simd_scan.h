@@ -0,0 +1,61 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * Kernels de pesquisa usados pelo parser HTTP, em versões AVX2 (32 bytes
+ * por iteração), SSE2 (16 bytes) e escalar. A versão é escolhida no arranque
+ * a partir do CPUID (__builtin_cpu_supports); fora de x86 usa-se sempre a
+ * versão escalar.
+ */
+
+typedef enum {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2
+} simd_level_t;
+
+
+/**
+ * Nível escolhido pelo CPUID (o melhor suportado por este CPU).
+ */
+simd_level_t simd_scan_level(void);
+
+
+/**
+ * Força um nível (benchmarks/comparações). Não é thread-safe: chamar antes
+ * de haver threads a fazer parsing.
+ * Retorna 0 em sucesso, -1 se o CPU não suporta esse nível.
+ */
+int simd_scan_force(simd_level_t level);
+
+
+/**
+ * Nome do nível ("scalar", "sse2", "avx2").
+ */
+const char* simd_level_name(simd_level_t level);
+
+
+/**
+ * Índice do primeiro byte de controlo (< 0x20 ou 0x7f) em p[0..n[,
+ * ou n se não houver. Usado para saltar o valor de um header até ao '\r'.
+ */
+size_t simd_find_ctl(const char* p, size_t n);
+
+
+/**
+ * Como simd_find_ctl(), mas também pára no espaço (fim do path na request line).
+ */
+size_t simd_find_ctl_or_space(const char* p, size_t n);
+
+
+/**
+ * Compara n bytes de s, sem distinguir maiúsculas, com 'lower' (já em
+ * minúsculas, apenas letras, dígitos e '-', como os nomes de headers).
+ * s tem de conter só tchars (garantido pelo parser). Retorna 1 se iguais.
+ */
+int simd_equals_lower(const char* s, const char* lower, size_t n);
+
+
+#endif /* SIMD_SCAN_H */
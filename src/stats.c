@@ -24,6 +24,7 @@ static void update_status_counter(server_stats_t* st, int status_code){
     {
     case 200: st->status_200++; break;
     case 206: st->status_206++; break;
+    case 304: st->status_304++; break;
     case 400: st->status_400++; break;
     case 404: st->status_404++; break;
     case 405: st->status_405++; break;
@@ -89,7 +90,8 @@ int stats_request_end(shared_data_t* data,
 
 int stats_record_503(shared_data_t* data,
                      semaphores_t* sems,
-                     size_t bytes_sent)
+                     size_t bytes_sent,
+                     int shed)
 {
     if (!data || !sems) return -1;
 
@@ -103,6 +105,7 @@ int stats_record_503(shared_data_t* data,
     st->total_requests++;
     st->bytes_transferred += (long)bytes_sent;
     st->status_503++;
+    if (shed) st->load_shed++;
 
     sem_post(sems->stats_mutex);
     return 0;
@@ -132,6 +135,30 @@ int stats_cache_access(shared_data_t* data,
 }
 
 
+int stats_queue_depth(shared_data_t* data,
+                      semaphores_t* sems,
+                      size_t capacity,
+                      size_t high_water)
+{
+    if (!data || !sems) return -1;
+
+    if (safe_sem_wait(sems->stats_mutex) == -1) {
+        perror("sem_wait(stats_mutex) in stats_queue_depth");
+        return -1;
+    }
+
+    server_stats_t* st = &data->stats;
+
+    st->queue_capacity = (long)capacity;
+    if ((long)high_water > st->queue_high_water) {
+        st->queue_high_water = (long)high_water;
+    }
+
+    sem_post(sems->stats_mutex);
+    return 0;
+}
+
+
 void stats_print(shared_data_t* data, semaphores_t* sems, double uptime_seconds) {
     if (!data || !sems) return;
 
@@ -166,12 +193,15 @@ void stats_print(shared_data_t* data, semaphores_t* sems, double uptime_seconds)
     printf("Uptime: %.0f seconds\n", uptime_seconds);
     printf("Total Requests: %ld\n", cpy.total_requests);
     printf("Successful (2xx): %ld\n", successful_2xx);
+    printf("Not Modified (304): %ld\n", cpy.status_304);
     printf("Client Errors (4xx): %ld\n", client_4xx);
     printf("Server Errors (5xx): %ld\n", server_5xx);
     printf("Bytes Transferred: %ld\n", cpy.bytes_transferred);
     printf("Average Response Time: %.1f ms\n", avg_response_time);
     printf("Active Connections: %d\n", cpy.active_connections);
     printf("Cache Hit Rate: %.1f%%\n", cache_hit_rate);
+    printf("Queue High-Water Mark: %ld / %ld\n", cpy.queue_high_water, cpy.queue_capacity);
+    printf("Load Shed (CoDel): %ld\n", cpy.load_shed);
     printf("========================================\n");
     fflush(stdout);     // garantir que imprime imediatamente
 }
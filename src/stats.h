@@ -29,12 +29,14 @@ int stats_request_end(shared_data_t* data,
 
 
 /**
- * Uso específico para 503 gerados pelo master (queue cheia).
+ * Uso específico para 503 de controlo de carga (queue cheia ou CoDel).
  * Aqui não mexemos em active_connections.
+ * shed != 0 conta também o 503 em load_shed (rejeitado pelo CoDel).
  */
 int stats_record_503(shared_data_t* data,
                      semaphores_t* sems,
-                     size_t bytes_sent);
+                     size_t bytes_sent,
+                     int shed);
 
 
 /**
@@ -54,4 +56,14 @@ int stats_cache_access(shared_data_t* data,
                        int hit);
 
 
+/**
+ * Regista a capacidade e o high-water mark da fila de ligações de um worker
+ * process. Guarda o máximo entre todos os processos.
+ */
+int stats_queue_depth(shared_data_t* data,
+                      semaphores_t* sems,
+                      size_t capacity,
+                      size_t high_water);
+
+
 #endif /* STATS_H */
@@ -6,7 +6,6 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
-#include <ctype.h>
 
 #include "stats.h"
 #include "worker.h"
@@ -14,44 +13,19 @@
 #include "http.h"
 #include "cache.h"
 #include "logger.h"
+#include "event_loop.h"
+#include "http_parser.h"
+#include "codel.h"
+
+// Nº máximo de pedidos seguidos da mesma ligação antes de a devolver ao event loop
+#define MAX_REQUESTS_PER_DISPATCH 32
 
 
 /**
- * Consumer: retira um client_fd da fila usando semáforos (filled/empty + queue_mutex).
+ * Consumer: retira um client_fd da fila lock-free (bloqueia num futex se estiver vazia).
  */
-int dequeue_connection(shared_data_t* data, semaphores_t* sems) {
-    int client_fd;
-
-    // Esperar por item disponível
-    while (sem_wait(sems->filled_slots) == -1) {
-        if (errno == EINTR) {
-            if (!keep_running) return -1;
-            continue;
-        }   
-        perror("sem_wait(filled_slots)");
-        return -1;
-    }
-
-    if (sem_wait(sems->queue_mutex) == -1) {
-        perror("sem_wait(queue_mutex)");
-        // devolve o filled_slots consumido
-        sem_post(sems->filled_slots);
-        return -1;
-    }
-
-    if (data->queue.count == 0) {
-        sem_post(sems->queue_mutex);
-        return -1;
-    }
-
-    client_fd = data->queue.sockets[data->queue.front];
-    data->queue.front = (data->queue.front + 1) % MAX_QUEUE_SIZE;
-    data->queue.count--;
-
-    sem_post(sems->queue_mutex);
-    sem_post(sems->empty_slots);
-
-    return client_fd;
+int dequeue_connection(connection_queue_t* queue, uint64_t* enqueued_ns) {
+    return conn_queue_pop(queue, enqueued_ns);
 }
 
 
@@ -62,55 +36,11 @@ static double now_monotonic_sec() {
     return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-// lê o pedido HTTP até encontrar "\r\n\r\n" ou encher o buffer
-static ssize_t recv_http_request(int client_fd, char* buf, size_t buf_size) {
-    size_t total = 0;
-    
-    // Loop para ler dados até ter um pedido HTTP completo
-    while (total < buf_size - 1) {
-        // Tenta receber dados do socket do cliente
-        ssize_t n = recv(client_fd, buf + total, buf_size - 1 - total, 0);
-        
-        // Tratar erros de receção
-        if (n < 0) {
-            if (errno == EINTR) continue;  // Sinal interrompeu -> tenta novamente
-            return -1;
-        }
-        
-        // Se recv retorna 0, o cliente fechou a ligação
-        if (n == 0) break;
-        
-        // Avançar o contador de bytes lidos
-        total += (size_t)n;
-        buf[total] = '\0';  // Terminar string para poder usar strstr()
-        
-        // Verificar se já temos o fim do header HTTP ("\r\n\r\n")
-        if (strstr(buf, "\r\n\r\n")) {
-            break;  // Pedido completo recebido
-        }
-    }
-    
-    // Se não recebemos nada, erro
-    if (total == 0) return -1;
-    
-    // Garantir que a string está terminada com '\0'
-    buf[total] = '\0';
-    
-    // Retornar número de bytes lidos
-    return (ssize_t)total;
-}
-
-// procura substring case-insensitive simples
-static int contains_ci(const char* haystack, const char* needle) {
-    if (!haystack || !needle) return 0;
-    size_t nlen = strlen(needle);
-    for (const char* p = haystack; *p; ++p) {
-        size_t i = 0;
-        while (p[i] && i < nlen && tolower((unsigned char)p[i]) == tolower((unsigned char)needle[i])) {
-            i++;
-        }
-        if (i == nlen) return 1;
-    }
+/* Copia uma fatia do pedido para uma string terminada em '\0'. Retorna -1 se não couber. */
+static int copy_slice(char* dst, size_t dst_sz, const char* buf, http_slice_t s) {
+    if (s.len >= dst_sz) return -1;
+    memcpy(dst, buf + s.off, s.len);
+    dst[s.len] = '\0';
     return 0;
 }
 
@@ -152,25 +82,101 @@ static int build_full_path(const worker_args_t* args, const char* req_path, char
     return 0;
 }
 
-static void handle_client_connection(int client_fd, worker_args_t* args) {
-    // Configurar timeout de socket por ligação (aplica-se a cada recv)
-    // Evita que uma thread fique eternamente à espera de um novo request da mesma ligação
-    int timeout_sec = (args->config && args->config->timeout_seconds > 0) ? args->config->timeout_seconds : 30;
-    struct timeval tv = {.tv_sec = timeout_sec, .tv_usec = 0};
-    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+/**
+ * Envia uma resposta com corpo em memória, ou acumula-a no batch enquanto
+ * houver mais pedidos em pipeline já recebidos (pending): as respostas
+ * pequenas saem todas juntas, por ordem, com a última do pipeline.
+ * Retorna 0 em sucesso, -1 se o envio falhou.
+ */
+static int reply(int client_fd, http_batch_t* batch, int pending, int status_code,
+                 const char* status_msg, const char* content_type,
+                 const http_validators_t* validators,
+                 const char* body, size_t body_len, int keep_alive) {
+    pending = pending && keep_alive;   // depois de "Connection: close" não há mais respostas
+
+    if (!pending && batch->len == 0) {
+        return send_http_response(client_fd, status_code, status_msg, content_type, validators,
+                                  body, body_len, keep_alive);
+    }
+    if (http_batch_response(batch, status_code, status_msg, content_type, validators,
+                            body, body_len, keep_alive) == 0) {
+        return pending ? 0 : http_batch_flush(client_fd, batch);
+    }
+    // Não cabe no batch: enviar primeiro as respostas anteriores (ordem do pipeline)
+    if (http_batch_flush(client_fd, batch) < 0) return -1;
+    return send_http_response(client_fd, status_code, status_msg, content_type, validators,
+                              body, body_len, keep_alive);
+}
+
+
+/* Igual a reply(), para respostas 206 com corpo em memória. */
+static int reply_range(int client_fd, http_batch_t* batch, int pending,
+                       const char* content_type, const http_validators_t* validators,
+                       const char* body, size_t total_size,
+                       long range_start, long range_end, int keep_alive) {
+    pending = pending && keep_alive;
+
+    if (!pending && batch->len == 0) {
+        return send_http_response_range(client_fd, content_type, validators, body, total_size,
+                                        range_start, range_end, keep_alive);
+    }
+    if (http_batch_response_range(batch, content_type, validators, body, total_size,
+                                  range_start, range_end, keep_alive) == 0) {
+        return pending ? 0 : http_batch_flush(client_fd, batch);
+    }
+    if (http_batch_flush(client_fd, batch) < 0) return -1;
+    return send_http_response_range(client_fd, content_type, validators, body, total_size,
+                                    range_start, range_end, keep_alive);
+}
+
 
+/* Igual a reply(), para respostas com o header já formatado (hits do cache, erros fixos). */
+static int reply_preformatted(int client_fd, http_batch_t* batch, int pending,
+                              const char* header, size_t header_len,
+                              const char* body, size_t body_len, int keep_alive) {
+    pending = pending && keep_alive;
+
+    if (!pending && batch->len == 0) {
+        return send_http_preformatted(client_fd, header, header_len, body, body_len);
+    }
+    if (http_batch_preformatted(batch, header, header_len, body, body_len) == 0) {
+        return pending ? 0 : http_batch_flush(client_fd, batch);
+    }
+    if (http_batch_flush(client_fd, batch) < 0) return -1;
+    return send_http_preformatted(client_fd, header, header_len, body, body_len);
+}
+
+
+/* Envia uma das respostas de erro fixas (todas fecham a ligação) e devolve o
+   status; *bytes_sent fica com o tamanho do corpo (o que as stats contam). */
+static int reply_error(int client_fd, http_batch_t* batch, http_error_t err, size_t* bytes_sent) {
+    const http_blob_t* blob = http_error_response(err);
+    reply_preformatted(client_fd, batch, 0, blob->data, blob->len, NULL, 0, 0);
+    *bytes_sent = blob->body_len;
+    return blob->status_code;
+}
+
+
+/**
+ * Trata os pedidos de uma ligação entregue pelo event loop.
+ * Quando é chamada, conn->buf já contém um pedido completo. Depois de responder,
+ * tenta ler o próximo pedido sem bloquear; se ainda não chegou, a ligação volta
+ * a ser estacionada no epoll e a thread fica livre para outras ligações.
+ *
+ * Pipelining: os bytes depois do pedido atual ficam no buffer da ligação
+ * (conn_consume) e os pedidos seguintes são tratados por ordem. As respostas
+ * de pedidos que já estavam no buffer são acumuladas e enviadas juntas.
+ */
+static void handle_client_connection(connection_t* conn, worker_args_t* args) {
+    static __thread http_batch_t batch_buf;   // respostas pendentes desta thread
+    http_batch_t* batch = &batch_buf;
+    int client_fd = conn->fd;
     int keep_alive = 1;
+    int served = 0;
 
-    while (keep_running && keep_alive) {
-        // Buffer para armazenar o pedido HTTP recebido
-        char req_buf[8192]; // 8KB deve ser suficiente para headers
-        // Lê o pedido do socket até encontrar o fim dos headers
-        ssize_t rlen = recv_http_request(client_fd, req_buf, sizeof(req_buf));
-        if (rlen <= 0) {
-            // Cliente fechou ou erro de leitura -> terminar ligação sem contabilizar novo pedido
-            break;
-        }
+    batch->len = 0;
 
+    while (keep_running && keep_alive) {
         double start_time = now_monotonic_sec();
 
         // Regista pedido em processamento (um por request)
@@ -179,141 +185,192 @@ static void handle_client_connection(int client_fd, worker_args_t* args) {
         // Valores por omissão para o resultado do handler
         int status_code = 500;
         size_t bytes_sent = 0;
-        char* file_data = NULL;
-        size_t file_size = 0;
-        int from_cache = 0;
-        int cache_hit = 0;
+        cache_file_t file = { .data = NULL, .size = 0, .fd = -1 };
         int request_ok = 0; // 1 se parse GET válido
 
-        // Estrutura para guardar método, caminho e versão
+        // O pedido já foi analisado por conn_fill() (parser incremental da ligação)
+        http_parser_t* hp = &conn->parser;
+        const char* req_buf = conn->buf;
+        int parsed = http_parser_execute(hp, req_buf, conn->len) == HTTP_PARSE_DONE;
+
+        // Copiar o que precisamos do pedido antes de o descartar do buffer
         http_request_t req;
+        static __thread char range_value[256];
+        static __thread char if_none_match[256];
+        static __thread char if_modified_since[64];
+        int has_range_header = 0;
+        int has_if_none_match = 0;
+        int has_if_modified_since = 0;
+        int accepts_gzip = 0;
+        int want_close = 1;
+        // Um pedido com corpo leva 400 e fecha a ligação (o corpo nunca é lido)
+        if (parsed && !http_parser_has_body(hp, req_buf) &&
+            copy_slice(req.method, sizeof(req.method), req_buf, hp->method_str) == 0 &&
+            copy_slice(req.path, sizeof(req.path), req_buf, hp->path) == 0 &&
+            copy_slice(req.version, sizeof(req.version), req_buf, hp->version) == 0) {
+            request_ok = 1;
+
+            // Determinar se a conexão fica aberta (HTTP/1.0 fecha por omissão)
+            if (http_header_has_token(hp, req_buf, HTTP_HDR_CONNECTION, "close")) {
+                want_close = 1;
+            } else if (http_header_has_token(hp, req_buf, HTTP_HDR_CONNECTION, "keep-alive")) {
+                want_close = 0;
+            } else {
+                want_close = (hp->version_minor == 0);
+            }
+
+            size_t value_len = 0;
+            const char* value = http_parser_header(hp, req_buf, HTTP_HDR_RANGE, &value_len);
+            if (value && value_len < sizeof(range_value)) {
+                memcpy(range_value, value, value_len);
+                range_value[value_len] = '\0';
+                has_range_header = 1;
+            }
+
+            // Validadores do pedido condicional (um If-None-Match demasiado longo é ignorado: 200)
+            has_if_none_match = hp->headers[HTTP_HDR_IF_NONE_MATCH].len > 0 &&
+                copy_slice(if_none_match, sizeof(if_none_match), req_buf,
+                           hp->headers[HTTP_HDR_IF_NONE_MATCH]) == 0;
+            has_if_modified_since = hp->headers[HTTP_HDR_IF_MODIFIED_SINCE].len > 0 &&
+                copy_slice(if_modified_since, sizeof(if_modified_since), req_buf,
+                           hp->headers[HTTP_HDR_IF_MODIFIED_SINCE]) == 0;
+
+            value = http_parser_header(hp, req_buf, HTTP_HDR_ACCEPT_ENCODING, &value_len);
+            accepts_gzip = value && http_accepts_gzip(value, value_len);
+        }
+        http_method_t method = hp->method;
+
+        // Descartar o pedido e analisar já o seguinte (pipelining): se estiver
+        // completo, a resposta atual pode ficar no batch
+        conn_consume(conn, parsed ? hp->header_len : conn->len);
+        int pending = http_parser_execute(&conn->parser, conn->buf, conn->len) != HTTP_PARSE_AGAIN;
+
         // Só aceitamos pedidos GET bem formatados
-        if (parse_http_request(req_buf, &req) < 0) {
-            const char* body = "<html><body><h1>400 Bad Request</h1></body></html>";
-            bytes_sent = strlen(body);
-            status_code = 400;
+        if (!request_ok) {
             keep_alive = 0;
-            send_http_response(client_fd, status_code, "Bad Request", "text/html", body, bytes_sent, keep_alive);
+            status_code = reply_error(client_fd, batch, HTTP_ERR_400, &bytes_sent);
             goto finish_request;
         }
-        request_ok = 1;
-
-        // Determinar se a conexão fica aberta
-        int want_close = 0;
-        if (contains_ci(req_buf, "connection: close")) {
-            want_close = 1;
-        } else if (contains_ci(req_buf, "connection: keep-alive")) {
-            want_close = 0;
-        } else {
-            if (strcmp(req.version, "HTTP/1.0") == 0) {     // HTTP/1.0 fecha por omissão
-                want_close = 1;
-            }
-        }
         keep_alive = want_close ? 0 : 1;
 
-        if (strcmp(req.method, "GET") != 0) {
-            const char* body = "<html><body><h1>405 Method Not Allowed</h1></body></html>";
-            bytes_sent = strlen(body);
-            status_code = 405;
+        if (method != HTTP_METHOD_GET) {
             keep_alive = 0; // métodos não suportados: fechamos
-            send_http_response(client_fd, status_code, "Method Not Allowed", "text/html", body, bytes_sent, keep_alive);
+            status_code = reply_error(client_fd, batch, HTTP_ERR_405, &bytes_sent);
             goto finish_request;
         }
 
         // Construir o caminho absoluto do ficheiro a servir
         char full_path[1024];
         if (build_full_path(args, req.path, full_path, sizeof(full_path)) != 0) {
-            const char* body = "<html><body><h1>400 Bad Request</h1></body></html>";
-            bytes_sent = strlen(body);
-            status_code = 400;
             keep_alive = 0;
-            send_http_response(client_fd, status_code, "Bad Request", "text/html", body, bytes_sent, keep_alive);
+            status_code = reply_error(client_fd, batch, HTTP_ERR_400, &bytes_sent);
             goto finish_request;
         }
 
         // Tenta obter o ficheiro do cache; se não existir, lê do disco e insere se couber
-        if (cache_get_file(full_path, &file_data, &file_size, &from_cache, &cache_hit) != 0) {
-            stats_cache_access(args->shared, args->sems, 0); // miss
-            const char* body = "<html><body><h1>404 Not Found</h1></body></html>";
-            bytes_sent = strlen(body);
-            status_code = 404;
+        // (ficheiros grandes vêm como fd aberto para sendfile)
+        if (cache_get_file(full_path, &file) != 0) {
+            if (!file.is_hit) {
+                stats_cache_access(args->shared, args->sems, 0); // miss (um 404 do cache negativo não foi ao disco)
+            }
             keep_alive = 0; // fechamos em erro
-            send_http_response(client_fd, status_code, "Not Found", "text/html", body, bytes_sent, keep_alive);
+            status_code = reply_error(client_fd, batch, HTTP_ERR_404, &bytes_sent);
             goto finish_request;
         }
 
         // Contabilizar hit/miss de cache
-        stats_cache_access(args->shared, args->sems, cache_hit);
-
-        // Detectar e processar Range header
-        static __thread char range_value[256];
-        range_request_t range;
-        int has_range_header = 0;
-
-        // Procurar header "Range:" no pedido
-        const char* range_start = strstr(req_buf, "Range:");
-        if (!range_start) {
-            range_start = strstr(req_buf, "range:");
-        }
-
-        if (range_start) {
-            // Encontrar o fim da linha do header
-            const char* range_end = strstr(range_start, "\r\n");
-            if (range_end) {
-                // Extrair valor após "Range: " ou "range: "
-                const char* value_start = strchr(range_start, ':');
-                if (value_start) {
-                    value_start++;
-                    while (*value_start == ' ') value_start++;
-
-                    size_t value_len = range_end - value_start;
-                    if (value_len < sizeof(range_value)) {
-                        strncpy(range_value, value_start, value_len);
-                        range_value[value_len] = '\0';
-                        has_range_header = 1;
-                    }
-                }
+        stats_cache_access(args->shared, args->sems, file.is_hit);
+
+        // Variante gzip (se o cache já a tem): um Range aplica-se sempre à versão original
+        int use_gzip = accepts_gzip && !has_range_header && file.gzip.data != NULL;
+        const http_validators_t* validators = use_gzip ? file.gzip.validators : file.validators;
+
+        // Pedido condicional: o cliente já tem esta versão (antes do Range, como manda o RFC 9110)
+        if ((has_if_none_match || has_if_modified_since) &&
+            http_not_modified(has_if_none_match ? if_none_match : NULL,
+                              has_if_modified_since ? if_modified_since : NULL,
+                              validators, file.mtime_ns)) {
+            char header[512];
+            int header_len = http_format_not_modified(header, sizeof(header), validators,
+                                                      keep_alive);
+            if (header_len < 0 || (size_t)header_len >= sizeof(header) ||
+                reply_preformatted(client_fd, batch, pending, header, (size_t)header_len,
+                                   NULL, 0, keep_alive) < 0) {
+                keep_alive = 0;
             }
+            status_code = 304;
+            bytes_sent = 0;
+            goto finish_request;
         }
 
+        // Processar Range header
+        range_request_t range;
+
         if (has_range_header) {
             // Validar o range
-            if (parse_range_header(range_value, &range, file_size) == 0 && range.has_range) {
+            if (parse_range_header(range_value, &range, file.size) == 0 && range.has_range) {
                 // Range válido - enviar 206 Partial Content
-                send_http_response_range(
-                    client_fd,
-                    "application/octet-stream",
-                    file_data,
-                    file_size,
-                    range.start,
-                    range.end,
-                    keep_alive
-                );
+                int rc;
+                if (file.fd >= 0) {
+                    // sendfile: as respostas anteriores do pipeline têm de sair primeiro
+                    rc = http_batch_flush(client_fd, batch);
+                    if (rc == 0) {
+                        rc = send_http_response_range_file(client_fd, file.content_type,
+                            file.validators, file.fd, file.size, range.start, range.end, keep_alive);
+                    }
+                } else {
+                    rc = reply_range(
+                        client_fd, batch, pending,
+                        file.content_type,
+                        file.validators,
+                        file.data,
+                        file.size,
+                        range.start,
+                        range.end,
+                        keep_alive
+                    );
+                }
+                if (rc < 0) keep_alive = 0;  // resposta truncada: a ligação não é reutilizável
                 status_code = 206;
                 bytes_sent = range.end - range.start + 1;
             } else {
                 // Range inválido - enviar 416 Range Not Satisfiable
-                char error_body[256];
-                int error_len = snprintf(error_body, sizeof(error_body),
-                    "<html><body><h1>416 Range Not Satisfiable</h1></body></html>");
-                bytes_sent = error_len;
-                status_code = 416;
                 keep_alive = 0;
-                send_http_response(client_fd, status_code, "Range Not Satisfiable",
-                    "text/html", error_body, bytes_sent, keep_alive);
+                status_code = reply_error(client_fd, batch, HTTP_ERR_416, &bytes_sent);
             }
         } else {
             // Sem Range header - comportamento normal
-            send_http_response(
-                client_fd,
-                200, "OK",
-                "application/octet-stream",
-                file_data,
-                file_size,
-                keep_alive
-            );
+            int rc;
+            if (use_gzip) {
+                // Comprimida uma vez pelo cache: headers (Content-Encoding, Vary) já formatados
+                rc = reply_preformatted(client_fd, batch, pending,
+                    file.gzip.header[keep_alive], file.gzip.header_len[keep_alive],
+                    file.gzip.data, file.gzip.size, keep_alive);
+            } else if (file.fd >= 0) {
+                rc = http_batch_flush(client_fd, batch);
+                if (rc == 0) {
+                    rc = send_http_response_file(client_fd, 200, "OK", file.content_type,
+                        file.validators, file.fd, file.size, keep_alive);
+                }
+            } else if (file.header[keep_alive]) {
+                // Hit: header pré-formatado guardado com a entrada (sem snprintf)
+                rc = reply_preformatted(client_fd, batch, pending,
+                    file.header[keep_alive], file.header_len[keep_alive],
+                    file.data, file.size, keep_alive);
+            } else {
+                rc = reply(
+                    client_fd, batch, pending,
+                    200, "OK",
+                    file.content_type,
+                    file.validators,
+                    file.data,
+                    file.size,
+                    keep_alive
+                );
+            }
+            if (rc < 0) keep_alive = 0;  // resposta truncada: a ligação não é reutilizável
             status_code = 200;
-            bytes_sent = file_size;
+            bytes_sent = use_gzip ? file.gzip.size : file.size;
         }
 
 finish_request:
@@ -335,18 +392,40 @@ finish_request:
         const char* log_ver    = request_ok ? req.version: "HTTP/1.1";
         logger_log_request(client_fd, log_method, log_path, log_ver, status_code, bytes_sent);
 
-        // Se não veio do cache, libertar o buffer alocado pelo disco
-        if (!from_cache && file_data) {
-            free(file_data);
-        }
+        // Fechar o fd de um ficheiro grande / libertar um buffer fora do cache
+        cache_release_file(&file);
 
         if (!keep_alive) {
             break;
         }
+
+        // Não monopolizar a thread com um único cliente muito ativo
+        if (++served >= MAX_REQUESTS_PER_DISPATCH) {
+            if (http_batch_flush(client_fd, batch) < 0) break;
+            if (pending) {
+                // Já há pedidos no buffer: o epoll não voltaria a avisar, voltar à fila
+                event_loop_requeue(conn);
+            } else {
+                event_loop_park(conn);
+            }
+            return;
+        }
+
+        conn_read_t r = conn_fill(conn);
+        if (r == CONN_READ_AGAIN) {
+            // Ligação idle: devolvê-la ao event loop em vez de bloquear em recv()
+            if (http_batch_flush(client_fd, batch) < 0) break;
+            event_loop_park(conn);
+            return;
+        }
+        if (r == CONN_READ_CLOSED) {
+            break;
+        }
     }
 
-    // Fecha a ligação ao cliente
-    close(client_fd);
+    // Enviar respostas ainda acumuladas e fechar a ligação ao cliente
+    http_batch_flush(client_fd, batch);
+    event_loop_close(conn);
 }
 
 
@@ -357,14 +436,17 @@ finish_request:
  *   while (keep_running) {
  *       fd = dequeue_connection(...)
  *       se fd < 0 -> continua
- *       handle_client_connection(fd, ...)
+ *       conn = event_loop_acquire(fd)
+ *       se o CoDel manda rejeitar -> 503 e fecha
+ *       handle_client_connection(conn, ...)
  *   }
  */
 void* worker_thread_main(void* arg) {
     worker_args_t* wargs = (worker_args_t*)arg;
 
     while (keep_running) {
-        int client_fd = dequeue_connection(wargs->shared, wargs->sems);
+        uint64_t enqueued_ns = 0;
+        int client_fd = dequeue_connection(wargs->queue, &enqueued_ns);
         if (client_fd < 0) {
             // Erro ou interrupção; se estamos a terminar, saímos do loop
             if (!keep_running) {
@@ -373,9 +455,182 @@ void* worker_thread_main(void* arg) {
             continue;
         }
 
-        // Tratar a ligação
-        handle_client_connection(client_fd, wargs);
+        connection_t* conn = event_loop_acquire(client_fd);
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+
+        // Load shedding: a ligação esperou demasiado numa fila que não está a escoar
+        if (codel_should_drop(wargs->codel, enqueued_ns, conn_queue_now_ns())) {
+            send_503_response(conn->fd, wargs->shared, wargs->sems, 1);
+            event_loop_close(conn);
+            continue;
+        }
+
+        // Tratar a ligação (até ficar idle ou fechar)
+        handle_client_connection(conn, wargs);
     }
 
     return NULL;
 }    
+
+
+int worker_process_main(int worker_id,
+                        shared_data_t* shared,
+                        semaphores_t* sems,
+                        server_config_t* config,
+                        int ready_fd)
+{
+    int exit_code = EXIT_FAILURE;
+    int threads_created = 0;
+    pthread_t* threads = NULL;
+
+    // Fila local deste processo, alocada com o MAX_QUEUE_SIZE configurado
+    if (config->max_queue_size > QUEUE_MAX_CAPACITY) {
+        fprintf(stderr, "Worker %d: MAX_QUEUE_SIZE=%d excede o limite, a usar %d\n",
+                worker_id, config->max_queue_size, QUEUE_MAX_CAPACITY);
+    }
+    connection_queue_t queue;
+    if (conn_queue_init(&queue, config->max_queue_size) < 0) {
+        perror("conn_queue_init");
+        if (ready_fd >= 0) close(ready_fd);
+        return EXIT_FAILURE;
+    }
+
+    // Política de envio das respostas com sendfile
+    http_set_tcp_cork(config->tcp_cork);
+
+    // Controlador CoDel partilhado pelas threads deste processo
+    codel_t codel;
+    codel_init(&codel, config->codel_target_ms, config->codel_interval_ms);
+    int queue_size = (int)queue.capacity;   // potência de 2 >= MAX_QUEUE_SIZE
+
+    // Socket de escuta próprio: o kernel balanceia accept() entre os processos
+    int listen_fd = create_server_socket(config->port, 1);
+    if (listen_fd < 0) {
+        perror("create_server_socket");
+        goto out_queue;
+    }
+
+    // Cache de ficheiros deste processo (MB -> bytes)
+    long cache_bytes = (config->cache_size_mb > 0) ? (long)config->cache_size_mb * 1024L * 1024L
+                                                   : CACHE_DEFAULT_MAX_BYTES;
+    if (cache_init(cache_bytes, config->cache_shards, config->cache_admission,
+                   config->cache_mmap) < 0) {
+        fprintf(stderr, "Worker %d: erro a inicializar cache de ficheiros\n", worker_id);
+        goto out_socket;
+    }
+    cache_shared_join(worker_id);   // só faz algo com CACHE_SHARED=1
+    cache_set_negative_ttl(config->negative_cache_ttl_ms);
+    if (cache_fd_init(config->fd_cache_entries, config->fd_cache_ttl_ms) < 0) {
+        fprintf(stderr, "Worker %d: cache de ficheiros abertos desligado\n", worker_id);
+    }
+    if (cache_set_gzip(config->cache_gzip) < 0) {
+        fprintf(stderr, "Worker %d: variantes gzip desligadas\n", worker_id);
+    }
+
+    // Deploys: ficheiros alterados em DOCUMENT_ROOT saem do cache sem reiniciar o servidor
+    const char* doc_root = (config->document_root[0] != '\0') ? config->document_root : "www";
+    if (cache_watch_start(doc_root) < 0) {
+        fprintf(stderr, "Worker %d: sem inotify, alterações detetadas pelo mtime (até 1s)\n", worker_id);
+    }
+
+    // Cada processo abre o seu FILE* (append); o log_mutex é partilhado
+    if (logger_init(config->log_file, sems) < 0) {
+        fprintf(stderr, "Worker %d: erro a inicializar logger\n", worker_id);
+        goto out_cache;
+    }
+
+    // Criar pool de worker threads (consumidores)
+    int total_threads = config->threads_per_worker;
+    if (total_threads <= 0) total_threads = 1; // fallback seguro
+
+    threads = calloc(total_threads, sizeof(pthread_t));
+    if (!threads) {
+        perror("calloc threads");
+        goto out_logger;
+    }
+
+    worker_args_t wargs = {
+        .shared = shared,
+        .sems = sems,
+        .queue = &queue,
+        .codel = &codel,
+        .config = config
+    };
+
+    for (int i = 0; i < total_threads; ++i) {
+        if (pthread_create(&threads[i], NULL, worker_thread_main, &wargs) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        threads_created++;
+    }
+    if (threads_created != total_threads) {
+        fprintf(stderr, "Worker %d: erro a criar pool de threads\n", worker_id);
+        goto out_threads;
+    }
+
+    // Event loop (epoll): aceita ligações e estaciona as ligações keep-alive idle
+    int idle_timeout = (config->timeout_seconds > 0) ? config->timeout_seconds : 30;
+    if (event_loop_init(listen_fd, &queue, shared, sems, idle_timeout) < 0) {
+        perror("event_loop_init");
+        goto out_threads;
+    }
+
+    printf("Worker %d (PID %d): a ouvir na porta %d (%d threads, queue size = %d)\n",
+           worker_id, (int)getpid(), config->port, total_threads, queue_size);
+    fflush(stdout);
+
+    // Arranque concluído: a partir daqui um erro já não é de configuração
+    if (ready_fd >= 0) {
+        if (write(ready_fd, "R", 1) < 0) perror("write(ready_fd)");
+        close(ready_fd);
+        ready_fd = -1;
+    }
+
+    time_t last_publish = 0;
+    while (keep_running) {
+        // Espera no máximo 1s por eventos, para reparar rapidamente no shutdown
+        if (event_loop_poll(1000) < 0) {
+            break;
+        }
+
+        // Publicar o high-water mark da fila (no máximo 1x por segundo,
+        // para não pôr o stats_mutex no caminho de cada enqueue)
+        time_t now = time(NULL);
+        if (now != last_publish) {
+            stats_queue_depth(shared, sems, queue.capacity, conn_queue_high_water(&queue));
+            last_publish = now;
+        }
+    }
+    exit_code = EXIT_SUCCESS;
+
+out_threads:
+    keep_running = 0;
+    // Acordar threads que possam estar bloqueadas à espera de ligações
+    conn_queue_close(&queue);
+    for (int i = 0; i < threads_created; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // Fechar ligações que ainda estejam estacionadas ou na fila
+    event_loop_destroy();
+out_logger:
+    logger_shutdown();
+out_cache:
+    if (exit_code == EXIT_SUCCESS) {
+        printf("Worker %d (PID %d): cache de ficheiros\n", worker_id, (int)getpid());
+        cache_print_stats(stdout);
+        fflush(stdout);
+    }
+    cache_destroy();
+out_socket:
+    close(listen_fd);
+out_queue:
+    conn_queue_destroy(&queue);
+    if (ready_fd >= 0) close(ready_fd);
+    return exit_code;
+}
@@ -5,24 +5,30 @@
 #include "shared_mem.h"
 #include "semaphores.h"
 #include "config.h"
+#include "conn_queue.h"
+#include "codel.h"
 
 /**
  * Argumentos passados a cada worker thread.
  */
 typedef struct {
-    shared_data_t*  shared;   // memória partilhada (queue + stats)
-    semaphores_t*   sems;     // semáforos (empty_slots, filled_slots, queue_mutex, ...)
-    server_config_t* config;  // config do servidor (document_root, etc) – para uso futuro
+    shared_data_t*  shared;        // memória partilhada (stats)
+    semaphores_t*   sems;          // semáforos (stats_mutex, log_mutex)
+    connection_queue_t* queue;     // fila de ligações deste worker process
+    codel_t*        codel;         // controlo de carga pelo atraso na fila
+    server_config_t* config;       // config do servidor (document_root, etc) – para uso futuro
 } worker_args_t;
 
 /**
- * Dequeue de uma conexão da fila partilhada.
+ * Dequeue de uma conexão da fila do worker process.
+ * Bloqueia enquanto a fila estiver vazia.
+ * Em enqueued_ns devolve o instante em que a ligação entrou na fila.
  *
  * Retorna:
  *   >=0  fd do socket de cliente
- *   -1   em erro (não mexe em sockets)
+ *   -1   se a fila foi fechada (shutdown)
  */
-int dequeue_connection(shared_data_t* data, semaphores_t* sems);
+int dequeue_connection(connection_queue_t* queue, uint64_t* enqueued_ns);
 
 /**
  * Função principal de cada worker thread (consumer).
@@ -30,4 +36,22 @@ int dequeue_connection(shared_data_t* data, semaphores_t* sems);
  */
 void* worker_thread_main(void* arg);
 
+/**
+ * Corpo de um worker process (chamado pelo master logo após o fork()).
+ *
+ * Cria o socket de escuta próprio (SO_REUSEPORT), a fila de ligações,
+ * o cache, o logger e o pool de THREADS_PER_WORKER threads, e corre o
+ * event loop até keep_running passar a 0.
+ *
+ * ready_fd : ponta de escrita de um pipe do master; recebe um byte quando o
+ *            worker já está a aceitar ligações e é fechado (-1 => não avisar).
+ *
+ * Retorna EXIT_SUCCESS no shutdown normal, EXIT_FAILURE em erro.
+ */
+int worker_process_main(int worker_id,
+                        shared_data_t* shared,
+                        semaphores_t* sems,
+                        server_config_t* config,
+                        int ready_fd);
+
 #endif /* WORKER_H */
\ No newline at end of file
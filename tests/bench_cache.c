@@ -0,0 +1,152 @@
+/*
+ * Microbenchmark de contenção no cache de ficheiros.
+ *
+ * 1/8/64 threads pedem repetidamente os mesmos ficheiros "quentes" (já em
+ * cache) com cache_get_file() + cache_release_file(), como as worker threads
+ * quando um site tem poucos assets muito populares. Mede a escalabilidade dos
+ * hits: com o CLOCK um hit só segura o RDLOCK e liga um bit atómico.
+ *
+ * Os ficheiros são criados num diretório temporário e apagados no fim.
+ *
+ * Uso: ./tests/bench_cache [operações]   (default: 4000000)
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../src/cache.h"
+
+#define DEFAULT_OPS 4000000L
+#define HOT_FILES 16
+#define HOT_FILE_SIZE 4096
+
+static char g_dir[] = "/tmp/bench_cache_XXXXXX";
+static char g_paths[HOT_FILES][128];
+
+typedef struct {
+    long ops;
+    unsigned int seed;
+    long hits;
+    long errors;
+} bench_thread_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void create_files(void) {
+    if (!mkdtemp(g_dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+
+    char buf[HOT_FILE_SIZE];
+    for (int i = 0; i < HOT_FILES; ++i) {
+        snprintf(g_paths[i], sizeof(g_paths[i]), "%s/hot%02d.css", g_dir, i);
+        memset(buf, 'a' + i, sizeof(buf));
+
+        int fd = open(g_paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0 || write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+            perror("create hot file");
+            exit(1);
+        }
+        close(fd);
+    }
+}
+
+static void remove_files(void) {
+    for (int i = 0; i < HOT_FILES; ++i) {
+        unlink(g_paths[i]);
+    }
+    rmdir(g_dir);
+}
+
+static void* hammer(void* arg) {
+    bench_thread_t* t = arg;
+    for (long i = 0; i < t->ops; ++i) {
+        int k = (int)(rand_r(&t->seed) % HOT_FILES);
+        cache_file_t file;
+        if (cache_get_file(g_paths[k], &file) < 0 || file.size != HOT_FILE_SIZE ||
+            file.data[0] != 'a' + k) {
+            t->errors++;
+        } else {
+            t->hits += file.is_hit;
+        }
+        cache_release_file(&file);
+    }
+    return NULL;
+}
+
+static double run(int threads, long ops, long* hits, long* errors) {
+    pthread_t tids[64];
+    bench_thread_t args[64];
+
+    double t0 = now_sec();
+    for (int i = 0; i < threads; ++i) {
+        args[i] = (bench_thread_t){ .ops = ops / threads, .seed = (unsigned int)(i + 1) };
+        pthread_create(&tids[i], NULL, hammer, &args[i]);
+    }
+    *hits = *errors = 0;
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(tids[i], NULL);
+        *hits += args[i].hits;
+        *errors += args[i].errors;
+    }
+    return now_sec() - t0;
+}
+
+
+int main(int argc, char* argv[]) {
+    long ops = DEFAULT_OPS;
+    if (argc > 1) {
+        ops = atol(argv[1]);
+        if (ops <= 0) ops = DEFAULT_OPS;
+    }
+
+    create_files();
+    if (cache_init(0, 0, 1, 0) < 0) {
+        remove_files();
+        return 1;
+    }
+
+    // Aquecer: cada ficheiro entra no cache uma vez
+    for (int i = 0; i < HOT_FILES; ++i) {
+        cache_file_t file;
+        if (cache_get_file(g_paths[i], &file) == 0) cache_release_file(&file);
+    }
+
+    printf("========================================\n");
+    printf(" FILE CACHE CONTENTION BENCHMARK\n");
+    printf("========================================\n");
+    printf("Operations: %ld  Hot files: %d x %d bytes\n\n", ops, HOT_FILES, HOT_FILE_SIZE);
+    printf("%-10s %12s %14s %10s\n", "Threads", "Time (s)", "Hits/s", "Hit rate");
+
+    static const int thread_counts[] = { 1, 8, 64 };
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i) {
+        int threads = thread_counts[i];
+        long done = ops / threads * threads;
+        long hits = 0, errors = 0;
+        double t = run(threads, ops, &hits, &errors);
+
+        printf("%-10d %12.3f %14.0f %9.1f%%\n", threads, t, done / t, 100.0 * hits / done);
+        if (errors > 0 || hits != done) {
+            printf("  ERRO: %ld erros, %ld hits de %ld\n", errors, hits, done);
+            ok = 0;
+        }
+    }
+
+    cache_destroy();
+    remove_files();
+
+    printf("\n%s\n", ok ? "✓ PASS: todos os pedidos foram hits com o conteúdo certo" : "✗ FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/*
+ * Microbenchmark do parsing de pedidos HTTP.
+ *
+ * Compara o caminho original (strstr do "\r\n\r\n", parse_http_request()
+ * com strncpy + sscanf, contains_ci() para o Connection e strstr do Range),
+ * reproduzido aqui tal como estava em http.c e worker.c, com o parser
+ * incremental atual (src/http_parser.c) em cada nível SIMD suportado pelo CPU.
+ *
+ * Os pedidos imitam os de um browser (User-Agent, Accept, Cookie, ...), com
+ * 700-1000 bytes de headers, que é onde o scan byte a byte pesa mais.
+ *
+ * Uso: ./tests/bench_parse [iterações]   (default: 1000000)
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "../src/http_parser.h"
+#include "../src/simd_scan.h"
+
+#define DEFAULT_ITERS 1000000L
+#define MAX_METHOD_LEN 16
+#define MAX_PATH_LEN   512
+#define MAX_VERSION_LEN 16
+
+typedef struct {
+    char method[MAX_METHOD_LEN];
+    char path[MAX_PATH_LEN];
+    char version[MAX_VERSION_LEN];
+} bench_request_t;
+
+/* Resultado que os dois caminhos têm de concordar */
+typedef struct {
+    long path_bytes;
+    long want_close;
+    long has_range;
+} bench_result_t;
+
+static const char* k_requests[] = {
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+    "image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: pt-PT,pt;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Cookie: _ga=GA1.1.1234567890.1712345678; session=7f3a9c2b4d5e6f708192a3b4c5d6e7f8; "
+    "prefs=theme%3Ddark%26lang%3Dpt; _ga_ABCDEF1234=GS1.1.1712345678.3.1.1712349999.0.0.0\r\n"
+    "\r\n",
+
+    "GET /assets/css/style.css HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "Referer: http://localhost:8080/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: pt-PT,pt;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Cookie: _ga=GA1.1.1234567890.1712345678; session=7f3a9c2b4d5e6f708192a3b4c5d6e7f8; "
+    "prefs=theme%3Ddark%26lang%3Dpt; _ga_ABCDEF1234=GS1.1.1712345678.3.1.1712349999.0.0.0\r\n"
+    "If-Modified-Since: Mon, 01 Apr 2024 10:00:00 GMT\r\n"
+    "\r\n",
+
+    "GET /media/video.mp4 HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/124.0.0.0 Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Accept-Encoding: identity;q=1, *;q=0\r\n"
+    "Accept-Language: pt-PT,pt;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: video\r\n"
+    "Referer: http://localhost:8080/index.html\r\n"
+    "Cookie: _ga=GA1.1.1234567890.1712345678; session=7f3a9c2b4d5e6f708192a3b4c5d6e7f8; "
+    "prefs=theme%3Ddark%26lang%3Dpt; _ga_ABCDEF1234=GS1.1.1712345678.3.1.1712349999.0.0.0\r\n"
+    "Range: bytes=1048576-\r\n"
+    "Connection: close\r\n"
+    "\r\n",
+};
+
+#define NUM_REQUESTS (sizeof(k_requests) / sizeof(k_requests[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* ---------- caminho original (strstr + sscanf + contains_ci) ---------- */
+
+static int parse_http_request(const char* buffer, bench_request_t* req) {
+    char* line_end = strstr(buffer, "\r\n");
+    if (!line_end) return -1;
+
+    char first_line[1024];
+    size_t len = line_end - buffer;
+    strncpy(first_line, buffer, len);
+    first_line[len] = '\0';
+
+    if (sscanf(first_line, "%s %s %s", req->method, req->path, req->version) != 3) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int contains_ci(const char* haystack, const char* needle) {
+    if (!haystack || !needle) return 0;
+    size_t nlen = strlen(needle);
+    for (const char* p = haystack; *p; ++p) {
+        size_t i = 0;
+        while (p[i] && i < nlen && tolower((unsigned char)p[i]) == tolower((unsigned char)needle[i])) {
+            i++;
+        }
+        if (i == nlen) return 1;
+    }
+    return 0;
+}
+
+static void run_legacy(const char* buf, bench_result_t* r) {
+    const char* headers_end = strstr(buf, "\r\n\r\n");
+    if (!headers_end) return;
+
+    bench_request_t req;
+    if (parse_http_request(buf, &req) < 0) return;
+    r->path_bytes += (long)strlen(req.path);
+
+    int want_close = 0;
+    if (contains_ci(buf, "connection: close")) {
+        want_close = 1;
+    } else if (contains_ci(buf, "connection: keep-alive")) {
+        want_close = 0;
+    } else {
+        want_close = strcmp(req.version, "HTTP/1.0") == 0;
+    }
+    r->want_close += want_close;
+
+    const char* range_start = strstr(buf, "Range:");
+    if (!range_start) range_start = strstr(buf, "range:");
+    r->has_range += range_start != NULL;
+}
+
+
+/* ---------- parser incremental ---------- */
+
+static void copy_slice(char* dst, size_t dst_sz, const char* buf, http_slice_t s) {
+    size_t n = s.len < dst_sz - 1 ? s.len : dst_sz - 1;
+    memcpy(dst, buf + s.off, n);
+    dst[n] = '\0';
+}
+
+static void run_parser(const char* buf, size_t len, bench_result_t* r) {
+    http_parser_t p;
+    http_parser_reset(&p);
+    if (http_parser_execute(&p, buf, len) != HTTP_PARSE_DONE) return;
+
+    bench_request_t req;
+    copy_slice(req.method, sizeof(req.method), buf, p.method_str);
+    copy_slice(req.path, sizeof(req.path), buf, p.path);
+    copy_slice(req.version, sizeof(req.version), buf, p.version);
+    r->path_bytes += (long)strlen(req.path);
+
+    int want_close = 0;
+    if (http_header_has_token(&p, buf, HTTP_HDR_CONNECTION, "close")) {
+        want_close = 1;
+    } else if (http_header_has_token(&p, buf, HTTP_HDR_CONNECTION, "keep-alive")) {
+        want_close = 0;
+    } else {
+        want_close = p.version_minor == 0;
+    }
+    r->want_close += want_close;
+
+    size_t range_len = 0;
+    r->has_range += http_parser_header(&p, buf, HTTP_HDR_RANGE, &range_len) != NULL;
+}
+
+
+static double bench_legacy(long iters, bench_result_t* r) {
+    double t0 = now_sec();
+    for (long i = 0; i < iters; ++i) {
+        run_legacy(k_requests[i % NUM_REQUESTS], r);
+    }
+    return now_sec() - t0;
+}
+
+static double bench_parser(long iters, const size_t* lens, bench_result_t* r) {
+    double t0 = now_sec();
+    for (long i = 0; i < iters; ++i) {
+        size_t k = (size_t)i % NUM_REQUESTS;
+        run_parser(k_requests[k], lens[k], r);
+    }
+    return now_sec() - t0;
+}
+
+static int same_result(const bench_result_t* a, const bench_result_t* b) {
+    return a->path_bytes == b->path_bytes && a->want_close == b->want_close &&
+           a->has_range == b->has_range;
+}
+
+
+int main(int argc, char* argv[]) {
+    long iters = DEFAULT_ITERS;
+    if (argc > 1) {
+        iters = atol(argv[1]);
+        if (iters <= 0) iters = DEFAULT_ITERS;
+    }
+
+    size_t lens[NUM_REQUESTS];
+    size_t total = 0;
+    for (size_t k = 0; k < NUM_REQUESTS; ++k) {
+        lens[k] = strlen(k_requests[k]);
+        total += lens[k];
+    }
+    simd_level_t best = simd_scan_level();
+
+    printf("========================================\n");
+    printf(" HTTP PARSE BENCHMARK\n");
+    printf("========================================\n");
+    printf("Iterations: %ld  Avg request: %zu bytes  CPU: %s\n\n",
+           iters, total / NUM_REQUESTS, simd_level_name(best));
+    printf("%-22s %12s %12s %10s\n", "Parser", "Time (s)", "ns/req", "MB/s");
+
+    bench_result_t ref = { 0, 0, 0 };
+    double t_legacy = bench_legacy(iters, &ref);
+    double mb = (double)total / NUM_REQUESTS * iters / (1024.0 * 1024.0);
+    printf("%-22s %12.3f %12.1f %10.0f\n", "strstr+sscanf (orig)", t_legacy,
+           t_legacy * 1e9 / iters, mb / t_legacy);
+
+    int ok = 1;
+    for (int level = SIMD_SCALAR; level <= (int)best; ++level) {
+        if (simd_scan_force((simd_level_t)level) < 0) continue;
+
+        bench_result_t r = { 0, 0, 0 };
+        double t = bench_parser(iters, lens, &r);
+        char label[32];
+        snprintf(label, sizeof(label), "http_parser (%s)", simd_level_name((simd_level_t)level));
+        printf("%-22s %12.3f %12.1f %10.0f   (x%.2f)\n", label, t, t * 1e9 / iters,
+               mb / t, t_legacy / t);
+
+        if (!same_result(&ref, &r)) {
+            printf("  ERRO: resultados diferentes do parser original\n");
+            ok = 0;
+        }
+    }
+    simd_scan_force(best);
+
+    printf("\n%s\n", ok ? "✓ PASS: todos os parsers deram o mesmo resultado" : "✗ FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/*
+ * Microbenchmark da fila de ligações.
+ *
+ * Compara a fila lock-free atual (src/conn_queue.c) com a fila original
+ * protegida por semáforos POSIX com nome (empty_slots / queue_mutex /
+ * filled_slots), reproduzida aqui tal como estava em enqueue_connection()
+ * e dequeue_connection().
+ *
+ * Cenário: 1 produtor (como o event loop) e 1/8/64 consumidores (worker threads).
+ * O produtor volta a tentar quando a fila está cheia (sched_yield), para que
+ * ambas as filas transportem exatamente o mesmo número de itens.
+ *
+ * Uso: ./tests/bench_queue [itens]   (default: 1000000)
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "../src/conn_queue.h"
+
+#define DEFAULT_ITEMS 1000000L
+#define BENCH_CAPACITY 128   // mesma capacidade nas duas filas (potência de 2 para o ring)
+
+/* ---------- fila original (semáforos + array circular) ---------- */
+
+typedef struct {
+    int sockets[BENCH_CAPACITY];
+    int front;
+    int rear;
+    int count;
+    sem_t* empty_slots;
+    sem_t* filled_slots;
+    sem_t* queue_mutex;
+} sem_queue_t;
+
+static sem_t* open_bench_sem(const char* base, unsigned int value) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s_%d", base, (int)getpid());
+    sem_unlink(name);
+    sem_t* sem = sem_open(name, O_CREAT | O_EXCL, 0600, value);
+    if (sem == SEM_FAILED) {
+        perror("sem_open");
+        exit(1);
+    }
+    sem_unlink(name);
+    return sem;
+}
+
+static void sem_queue_init(sem_queue_t* q) {
+    memset(q, 0, sizeof(*q));
+    q->empty_slots = open_bench_sem("/bench_empty", BENCH_CAPACITY);
+    q->filled_slots = open_bench_sem("/bench_filled", 0);
+    q->queue_mutex = open_bench_sem("/bench_mutex", 1);
+}
+
+static void sem_queue_destroy(sem_queue_t* q) {
+    sem_close(q->empty_slots);
+    sem_close(q->filled_slots);
+    sem_close(q->queue_mutex);
+}
+
+static int sem_queue_try_push(sem_queue_t* q, int fd) {
+    if (sem_trywait(q->empty_slots) == -1) {
+        return -1;
+    }
+    sem_wait(q->queue_mutex);
+    q->sockets[q->rear] = fd;
+    q->rear = (q->rear + 1) % BENCH_CAPACITY;
+    q->count++;
+    sem_post(q->queue_mutex);
+    sem_post(q->filled_slots);
+    return 0;
+}
+
+static int sem_queue_pop(sem_queue_t* q) {
+    while (sem_wait(q->filled_slots) == -1 && errno == EINTR) {
+    }
+    sem_wait(q->queue_mutex);
+    int fd = q->sockets[q->front];
+    q->front = (q->front + 1) % BENCH_CAPACITY;
+    q->count--;
+    sem_post(q->queue_mutex);
+    sem_post(q->empty_slots);
+    return fd;
+}
+
+/* ---------- infraestrutura do benchmark ---------- */
+
+typedef enum { IMPL_SEM, IMPL_RING } impl_t;
+
+typedef struct {
+    impl_t impl;
+    sem_queue_t* sq;
+    connection_queue_t* rq;
+    long items;
+    int consumers;
+} bench_ctx_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void push_retry(bench_ctx_t* ctx, int v) {
+    if (ctx->impl == IMPL_SEM) {
+        while (sem_queue_try_push(ctx->sq, v) < 0) sched_yield();
+    } else {
+        while (conn_queue_try_push(ctx->rq, v) < 0) sched_yield();
+    }
+}
+
+static void* consumer_main(void* arg) {
+    bench_ctx_t* ctx = arg;
+    long got = 0;
+    while (1) {
+        int v = (ctx->impl == IMPL_SEM) ? sem_queue_pop(ctx->sq) : conn_queue_pop(ctx->rq, NULL);
+        if (v < 0) break;   // sentinela: fim
+        got++;
+    }
+    return (void*)got;
+}
+
+static double run_bench(impl_t impl, long items, int consumers, long* consumed) {
+    sem_queue_t sq;
+    connection_queue_t rq;
+    bench_ctx_t ctx = { .impl = impl, .sq = &sq, .rq = &rq, .items = items, .consumers = consumers };
+
+    if (impl == IMPL_SEM) sem_queue_init(&sq);
+    else if (conn_queue_init(&rq, BENCH_CAPACITY) < 0) {
+        perror("conn_queue_init");
+        exit(1);
+    }
+
+    pthread_t* th = calloc(consumers, sizeof(pthread_t));
+    if (!th) {
+        perror("calloc");
+        exit(1);
+    }
+
+    double t0 = now_sec();
+    for (int i = 0; i < consumers; ++i) {
+        pthread_create(&th[i], NULL, consumer_main, &ctx);
+    }
+
+    for (long i = 0; i < items; ++i) {
+        push_retry(&ctx, (int)(i & 0x7fffffff));
+    }
+    for (int i = 0; i < consumers; ++i) {
+        push_retry(&ctx, -1);
+    }
+
+    long total = 0;
+    for (int i = 0; i < consumers; ++i) {
+        void* r;
+        pthread_join(th[i], &r);
+        total += (long)r;
+    }
+    double elapsed = now_sec() - t0;
+
+    free(th);
+    if (impl == IMPL_SEM) sem_queue_destroy(&sq);
+    else conn_queue_destroy(&rq);
+
+    *consumed = total;
+    return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    long items = (argc > 1) ? atol(argv[1]) : DEFAULT_ITEMS;
+    if (items <= 0) items = DEFAULT_ITEMS;
+
+    const int consumer_counts[] = { 1, 8, 64 };
+    const int ncounts = sizeof(consumer_counts) / sizeof(consumer_counts[0]);
+
+    printf("========================================\n");
+    printf(" CONNECTION QUEUE BENCHMARK\n");
+    printf("========================================\n");
+    printf("Items: %ld  Capacity: %d  Producers: 1\n\n", items, BENCH_CAPACITY);
+    printf("%-10s %-12s %12s %14s\n", "Consumers", "Queue", "Time (s)", "Ops/s");
+
+    int ok = 1;
+    for (int c = 0; c < ncounts; ++c) {
+        int consumers = consumer_counts[c];
+        long got_sem = 0, got_ring = 0;
+
+        double t_sem = run_bench(IMPL_SEM, items, consumers, &got_sem);
+        double t_ring = run_bench(IMPL_RING, items, consumers, &got_ring);
+
+        printf("%-10d %-12s %12.3f %14.0f\n", consumers, "semaphores", t_sem, items / t_sem);
+        printf("%-10d %-12s %12.3f %14.0f   (x%.2f)\n", consumers, "lock-free", t_ring,
+               items / t_ring, t_sem / t_ring);
+
+        if (got_sem != items || got_ring != items) {
+            printf("  ERRO: itens consumidos sem=%ld ring=%ld (esperado %ld)\n", got_sem, got_ring, items);
+            ok = 0;
+        }
+    }
+
+    printf("\n%s\n", ok ? "✓ PASS: todas as filas entregaram todos os itens" : "✗ FAIL");
+    return ok ? 0 : 1;
+}
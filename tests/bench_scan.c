@@ -0,0 +1,166 @@
+/*
+ * Microbenchmark de resistência a varrimentos do cache de ficheiros.
+ *
+ * Mistura tráfego de utilizadores (distribuição Zipf sobre um conjunto de
+ * ficheiros populares maior do que o cache) com um crawler que percorre
+ * sequencialmente milhares de ficheiros frios, cada um pedido uma só vez.
+ * Corre a mesma sequência com o CLOCK simples e com o filtro de admissão
+ * W-TinyLFU (CACHE_ADMISSION) e compara o hit rate dos utilizadores.
+ *
+ * Os ficheiros são criados num diretório temporário e apagados no fim.
+ *
+ * Uso: ./tests/bench_scan [pedidos]   (default: 400000)
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+
+#include "../src/cache.h"
+
+#define DEFAULT_OPS   400000L
+#define HOT_FILES     400
+#define COLD_FILES    8000
+#define FILE_SIZE     2048
+#define CACHE_BYTES   (256L * FILE_SIZE)     // cabem 256 ficheiros (< HOT_FILES)
+#define CACHE_SHARDS  4
+#define ZIPF_S        0.9
+#define CRAWL_PERCENT 50                     // % dos pedidos que vêm do crawler
+
+static char g_dir[] = "/tmp/bench_scan_XXXXXX";
+static char g_hot[HOT_FILES][96];
+static char g_cold[COLD_FILES][96];
+static double g_zipf_cdf[HOT_FILES];
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void create_file(const char* path) {
+    char buf[FILE_SIZE];
+    memset(buf, 'x', sizeof(buf));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        perror("create file");
+        exit(1);
+    }
+    close(fd);
+}
+
+static void create_files(void) {
+    if (!mkdtemp(g_dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    for (int i = 0; i < HOT_FILES; ++i) {
+        snprintf(g_hot[i], sizeof(g_hot[i]), "%s/hot%04d.html", g_dir, i);
+        create_file(g_hot[i]);
+    }
+    for (int i = 0; i < COLD_FILES; ++i) {
+        snprintf(g_cold[i], sizeof(g_cold[i]), "%s/cold%05d.html", g_dir, i);
+        create_file(g_cold[i]);
+    }
+}
+
+static void remove_files(void) {
+    for (int i = 0; i < HOT_FILES; ++i) unlink(g_hot[i]);
+    for (int i = 0; i < COLD_FILES; ++i) unlink(g_cold[i]);
+    rmdir(g_dir);
+}
+
+static void init_zipf(void) {
+    double sum = 0;
+    for (int i = 0; i < HOT_FILES; ++i) {
+        sum += 1.0 / pow(i + 1, ZIPF_S);
+        g_zipf_cdf[i] = sum;
+    }
+    for (int i = 0; i < HOT_FILES; ++i) {
+        g_zipf_cdf[i] /= sum;
+    }
+}
+
+static int zipf_pick(unsigned int* seed) {
+    double u = (double)rand_r(seed) / RAND_MAX;
+    int lo = 0, hi = HOT_FILES - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_zipf_cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Corre a sequência (sempre a mesma seed) e devolve o hit rate dos utilizadores */
+static double run(int admission, long ops, double* total_rate, double* secs) {
+    if (cache_init(CACHE_BYTES, CACHE_SHARDS, admission, 0) < 0) {
+        remove_files();
+        exit(1);
+    }
+
+    unsigned int seed = 12345;
+    long user_reqs = 0, user_hits = 0, hits = 0;
+    int crawl = 0;
+
+    double t0 = now_sec();
+    for (long i = 0; i < ops; ++i) {
+        int from_crawler = (int)(rand_r(&seed) % 100) < CRAWL_PERCENT;
+        const char* path = from_crawler ? g_cold[crawl++ % COLD_FILES] : g_hot[zipf_pick(&seed)];
+
+        cache_file_t file;
+        if (cache_get_file(path, &file) < 0) {
+            fprintf(stderr, "erro a ler %s\n", path);
+            exit(1);
+        }
+        hits += file.is_hit;
+        if (!from_crawler) {
+            user_reqs++;
+            user_hits += file.is_hit;
+        }
+        cache_release_file(&file);
+    }
+    *secs = now_sec() - t0;
+
+    cache_destroy();
+    *total_rate = 100.0 * hits / ops;
+    return user_reqs ? 100.0 * user_hits / user_reqs : 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    long ops = DEFAULT_OPS;
+    if (argc > 1) {
+        ops = atol(argv[1]);
+        if (ops <= 0) ops = DEFAULT_OPS;
+    }
+
+    create_files();
+    init_zipf();
+
+    printf("========================================\n");
+    printf(" FILE CACHE SCAN RESISTANCE BENCHMARK\n");
+    printf("========================================\n");
+    printf("Requests: %ld  Hot: %d (Zipf %.1f)  Cold (crawler, %d%%): %d  Cache: %ld files\n\n",
+           ops, HOT_FILES, ZIPF_S, CRAWL_PERCENT, COLD_FILES, CACHE_BYTES / FILE_SIZE);
+    printf("%-20s %12s %16s %10s\n", "Policy", "Time (s)", "User hit rate", "Hit rate");
+
+    double clock_total, tinylfu_total, t_clock, t_tinylfu;
+    double clock_user = run(0, ops, &clock_total, &t_clock);
+    printf("%-20s %12.3f %15.1f%% %9.1f%%\n", "CLOCK", t_clock, clock_user, clock_total);
+    double tinylfu_user = run(1, ops, &tinylfu_total, &t_tinylfu);
+    printf("%-20s %12.3f %15.1f%% %9.1f%%\n", "W-TinyLFU + CLOCK", t_tinylfu, tinylfu_user, tinylfu_total);
+
+    remove_files();
+
+    int ok = tinylfu_user > clock_user;
+    printf("\n%s\n", ok ? "✓ PASS: o filtro de admissão protege os ficheiros populares do crawler"
+                        : "✗ FAIL: o filtro de admissão não melhorou o hit rate");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/*
+ * Teste de regressão: variante gzip de um ficheiro que muda no disco.
+ *
+ * Sem inotify, um hit confirma a entrada com stat() no máximo 1x por segundo.
+ * Quando o ficheiro mudou, o pedido larga a entrada (e a variante gzip, que
+ * pode ser libertada) e lê o ficheiro outra vez. A entrada nova ainda não tem
+ * variante: o cache_file_t não pode ficar a apontar para a antiga, senão um
+ * cliente com "Accept-Encoding: gzip" recebe memória já libertada.
+ *
+ * O ficheiro é criado num diretório temporário e apagado no fim.
+ *
+ * Uso: ./tests/test_cache_gzip
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "../src/cache.h"
+
+#define FILE_SIZE 8192
+#define WAIT_STEP_US 10000
+#define WAIT_MAX_STEPS 500      // 5 s no máximo à espera do thread de compressão
+
+static char g_dir[] = "/tmp/test_cache_gzip_XXXXXX";
+static char g_path[128];
+
+static void write_file(char fill, int mtime_offset) {
+    char buf[FILE_SIZE];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = (i % 64 == 63) ? '\n' : fill;
+    }
+    int fd = open(g_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        perror("write file");
+        exit(1);
+    }
+    // mtime explícito: a mudança tem de ser visível mesmo com granularidade grosseira
+    struct timespec ts[2] = { { time(NULL) + mtime_offset, 0 }, { time(NULL) + mtime_offset, 0 } };
+    futimens(fd, ts);
+    close(fd);
+}
+
+/* 1 se data[0..size[ descomprime para FILE_SIZE bytes começados por fill */
+static int gunzip_matches(const char* data, size_t size, char fill) {
+    static char out[FILE_SIZE + 1];
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) return 0;
+    z.next_in = (unsigned char*)data;
+    z.avail_in = (unsigned int)size;
+    z.next_out = (unsigned char*)out;
+    z.avail_out = sizeof(out);
+    int rc = inflate(&z, Z_FINISH);
+    size_t got = sizeof(out) - z.avail_out;
+    inflateEnd(&z);
+    return rc == Z_STREAM_END && got == FILE_SIZE && out[0] == fill;
+}
+
+int main(void) {
+    if (!mkdtemp(g_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(g_path, sizeof(g_path), "%s/page.html", g_dir);
+    write_file('a', 0);
+
+    if (cache_init(0, 0, 1, 0) < 0 || cache_set_gzip(1) < 0) {
+        unlink(g_path);
+        rmdir(g_dir);
+        return 1;
+    }
+
+    int ok = 1;
+    cache_file_t file;
+
+    // 1º pedido: entra no cache; a variante é feita em fundo
+    if (cache_get_file(g_path, &file) == 0) cache_release_file(&file);
+    int have_gzip = 0;
+    for (int i = 0; i < WAIT_MAX_STEPS && !have_gzip; ++i) {
+        usleep(WAIT_STEP_US);
+        if (cache_get_file(g_path, &file) == 0) {
+            have_gzip = file.gzip.data && gunzip_matches(file.gzip.data, file.gzip.size, 'a');
+            cache_release_file(&file);
+        }
+    }
+    if (!have_gzip) {
+        printf("  ERRO: a variante gzip não apareceu\n");
+        ok = 0;
+    }
+
+    // Muda no disco; depois do intervalo de revalidação o hit confirma com stat()
+    write_file('b', 2);
+    sleep(2);
+    if (cache_get_file(g_path, &file) < 0) {
+        printf("  ERRO: cache_get_file falhou depois da alteração\n");
+        ok = 0;
+    } else {
+        if (file.size != FILE_SIZE || file.data[0] != 'b') {
+            printf("  ERRO: conteúdo antigo depois da alteração\n");
+            ok = 0;
+        }
+        // A entrada nova ainda não tem variante, ou tem a do conteúdo novo
+        if (file.gzip.data && !gunzip_matches(file.gzip.data, file.gzip.size, 'b')) {
+            printf("  ERRO: variante gzip da entrada antiga depois da alteração\n");
+            ok = 0;
+        }
+        cache_release_file(&file);
+    }
+
+    cache_destroy();
+    unlink(g_path);
+    rmdir(g_dir);
+
+    printf("%s\n", ok ? "✓ PASS: a variante gzip segue o ficheiro depois de mudar no disco" : "✗ FAIL");
+    return ok ? 0 : 1;
+}
@@ -21,6 +21,7 @@ echo "<html><body><h1>Test HTML</h1></body></html>" > www/index.html
 echo "body { color: blue; }" > www/style.css
 echo "console.log('test');" > www/script.js
 dd if=/dev/zero of=www/test.jpg bs=1K count=10 2>/dev/null
+for i in $(seq 1 100); do echo "<p>Linha $i de texto repetido</p>"; done > www/long.html
 
 # Iniciar servidor
 echo "Iniciando servidor..."
@@ -100,6 +101,43 @@ test_status "404 Not Found" "404" "http://localhost:8080/naoexiste.html"
 test_status "405 Method Not Allowed" "405" -X POST "http://localhost:8080/index.html"
 test_status "416 Range Not Satisfiable" "416" -H "Range: bytes=999999-" "http://localhost:8080/index.html"
 
+# 304 Not Modified - pedidos condicionais com os validadores da resposta anterior
+ETAG=$(curl -s -D - -o /dev/null "http://localhost:8080/index.html" | grep -i "^ETag:" | cut -d' ' -f2- | tr -d '\r')
+LAST_MODIFIED=$(curl -s -D - -o /dev/null "http://localhost:8080/index.html" | grep -i "^Last-Modified:" | cut -d' ' -f2- | tr -d '\r')
+test_status "304 Not Modified (If-None-Match)" "304" -H "If-None-Match: $ETAG" "http://localhost:8080/index.html"
+test_status "304 Not Modified (If-Modified-Since)" "304" -H "If-Modified-Since: $LAST_MODIFIED" "http://localhost:8080/index.html"
+test_status "200 com ETag diferente" "200" -H "If-None-Match: \"outra\"" "http://localhost:8080/index.html"
+
+# Variante gzip: comprimida em fundo depois do primeiro pedido, em cada worker process
+# (cada um com o seu cache). Repetir até uma resposta vir comprimida, no máximo ~5 s.
+GZIP_CE=""
+for i in $(seq 1 100); do
+    GZIP_HEADERS=$(curl -s -D - -o /tmp/test_gzip_body.gz -H "Accept-Encoding: gzip" "http://localhost:8080/long.html" | tr -d '\r')
+    GZIP_CE=$(echo "$GZIP_HEADERS" | grep -i "^Content-Encoding:" | cut -d' ' -f2-)
+    [ "$GZIP_CE" = "gzip" ] && break
+    sleep 0.05
+done
+GZIP_BODY=$(gunzip -c /tmp/test_gzip_body.gz 2>/dev/null | md5sum)
+if [ "$GZIP_CE" = "gzip" ] && [ "$GZIP_BODY" = "$(md5sum < www/long.html)" ]; then
+    echo -e "  ${GREEN}✓${NC} Content-Encoding: gzip (Accept-Encoding)"
+    PASSED=$((PASSED + 1))
+else
+    echo -e "  ${RED}✗${NC} Content-Encoding: gzip (sem variante comprimida ou corpo não descomprime para o original)"
+    FAILED=$((FAILED + 1))
+fi
+
+# Tipos comprimíveis: a resposta depende do Accept-Encoding (comprimida ou não)
+GZIP_VARY=$(echo "$GZIP_HEADERS" | grep -i "^Vary:" | cut -d' ' -f2-)
+PLAIN_VARY=$(curl -s -D - -o /dev/null "http://localhost:8080/long.html" | tr -d '\r' | grep -i "^Vary:" | cut -d' ' -f2-)
+if [ "$GZIP_VARY" = "Accept-Encoding" ] && [ "$PLAIN_VARY" = "Accept-Encoding" ]; then
+    echo -e "  ${GREEN}✓${NC} Vary: Accept-Encoding (com e sem gzip)"
+    PASSED=$((PASSED + 1))
+else
+    echo -e "  ${RED}✗${NC} Vary: '$GZIP_VARY' / '$PLAIN_VARY' (esperado Accept-Encoding)"
+    FAILED=$((FAILED + 1))
+fi
+rm -f /tmp/test_gzip_body.gz
+
 # 400 Bad Request - pedido mal formado
 echo "  Testando 400 Bad Request..."
 (echo -e "GET\r\n\r\n"; sleep 1) | nc localhost 8080 > /tmp/test_400.txt 2>&1
@@ -110,6 +148,23 @@ else
     echo -e "  ${YELLOW}⊘${NC} 400 Bad Request: Não testado (difícil via curl)"
 fi
 
+# Pedido com corpo (request smuggling): o corpo não pode ser tratado como outro pedido
+SMUGGLED="GET /style.css HTTP/1.1\r\nHost: x\r\n\r\n"
+exec 3<>/dev/tcp/localhost/8080
+printf "GET /index.html HTTP/1.1\r\nHost: x\r\nContent-Length: 36\r\n\r\n$SMUGGLED" >&3
+timeout 2 cat <&3 > /tmp/test_smuggle.txt
+exec 3<&-
+if [ "$(grep -c '^HTTP/1.1' /tmp/test_smuggle.txt)" = "1" ] && grep -q "^HTTP/1.1 400" /tmp/test_smuggle.txt; then
+    echo -e "  ${GREEN}✓${NC} 400 Bad Request: pedido com corpo (Content-Length) rejeitado"
+    PASSED=$((PASSED + 1))
+else
+    echo -e "  ${RED}✗${NC} Pedido com corpo: o corpo foi tratado como outro pedido"
+    FAILED=$((FAILED + 1))
+fi
+test_status "400 Bad Request (Transfer-Encoding)" "400" -H "Transfer-Encoding: chunked" "http://localhost:8080/index.html"
+test_status "400 Bad Request (Content-Length repetido)" "400" -H "Content-Length: 0" -H "Content-Length: 0" "http://localhost:8080/index.html"
+test_status "200 OK (Content-Length: 0)" "200" -H "Content-Length: 0" "http://localhost:8080/index.html"
+
 echo -e "  ${YELLOW}⊘${NC} 500 Server Error: Erro interno (não forçado)"
 echo -e "  ${YELLOW}⊘${NC} 503 Service Unavailable: Queue cheia (não testado)"
 
@@ -145,18 +200,24 @@ echo "━━━━━━━━━━━━━━━━━━━━━━━━
 
 test_content_type() {
     local ficheiro="$1"
+    local esperado="$2"
     
-    CONTENT_TYPE=$(curl -s -I "http://localhost:8080/$ficheiro" | grep -i "Content-Type:" | awk '{print $2}' | tr -d '\r')
+    # GET só com os cabeçalhos (HEAD não é suportado); ignora "; charset=..."
+    CONTENT_TYPE=$(curl -s -D - -o /dev/null "http://localhost:8080/$ficheiro" | grep -i "^Content-Type:" | awk '{print $2}' | tr -d '\r;')
     
-    echo -e "  ${BLUE}ℹ${NC} $ficheiro: $CONTENT_TYPE"
+    if [ "$CONTENT_TYPE" = "$esperado" ]; then
+        echo -e "  ${GREEN}✓${NC} $ficheiro: $CONTENT_TYPE"
+        PASSED=$((PASSED + 1))
+    else
+        echo -e "  ${RED}✗${NC} $ficheiro: '$CONTENT_TYPE' (esperado $esperado)"
+        FAILED=$((FAILED + 1))
+    fi
 }
 
-test_content_type "index.html"
-test_content_type "style.css"
-test_content_type "script.js"
-test_content_type "test.jpg"
-
-echo -e "  ${YELLOW}⊘${NC} Content-Type: Usa 'application/octet-stream' para todos"
+test_content_type "index.html" "text/html"
+test_content_type "style.css" "text/css"
+test_content_type "script.js" "text/javascript"
+test_content_type "test.jpg" "image/jpeg"
 
 echo ""
 